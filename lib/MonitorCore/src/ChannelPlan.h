@@ -0,0 +1,51 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+const int RF_CHANNELS = 13;
+
+// 2.4 GHz channels are 5 MHz apart with ~22 MHz wide spectral masks, so a
+// transmitter d channels away leaks (22 - 5d) / 22 of its power into ours.
+// That reaches zero past 4 channels.
+constexpr float channelOverlap(int d) {
+  return d < 0 ? channelOverlap(-d) : (d * 5 >= 22 ? 0.0f : (22.0f - 5.0f * d) / 22.0f);
+}
+
+// Row of the (banded, Toeplitz) 13x13 overlap matrix, centred on distance 0
+const int CHANNEL_OVERLAP_REACH = 4;
+constexpr float CHANNEL_OVERLAP_KERNEL[2 * CHANNEL_OVERLAP_REACH + 1] = {
+  channelOverlap(-4), channelOverlap(-3), channelOverlap(-2), channelOverlap(-1), channelOverlap(0),
+  channelOverlap(1),  channelOverlap(2),  channelOverlap(3),  channelOverlap(4),
+};
+
+const float RF_FLOOR_DBM = -100.0f;
+
+inline float mwToDbm(float mw) {
+  if (mw <= 0.0f) return RF_FLOOR_DBM;
+  float dbm = 10.0f * log10f(mw);
+  return dbm > RF_FLOOR_DBM ? dbm : RF_FLOOR_DBM;
+}
+
+// Apply the overlap kernel across neighbours: scoreDbm[ch] is the power
+// landing on ch from every channel within reach. Both arrays are indexed
+// by channel number, so [0] is unused.
+inline void spreadChannelPower(const float powerMw[RF_CHANNELS + 1], float scoreDbm[RF_CHANNELS + 1]) {
+  for (int ch = 1; ch <= RF_CHANNELS; ++ch) {
+    float mw = 0.0f;
+    for (int d = -CHANNEL_OVERLAP_REACH; d <= CHANNEL_OVERLAP_REACH; ++d) {
+      int src = ch + d;
+      if (src >= 1 && src <= RF_CHANNELS) mw += CHANNEL_OVERLAP_KERNEL[d + CHANNEL_OVERLAP_REACH] * powerMw[src];
+    }
+    scoreDbm[ch] = mwToDbm(mw);
+  }
+}
+
+// Lowest-scoring of the candidate channels; on a tie the earlier one wins
+inline uint8_t quietestChannel(const float scoreDbm[RF_CHANNELS + 1], const uint8_t* candidates, uint8_t count) {
+  uint8_t best = candidates[0];
+  for (uint8_t i = 1; i < count; ++i) {
+    if (scoreDbm[candidates[i]] < scoreDbm[best]) best = candidates[i];
+  }
+  return best;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+
+// Long-lived tables are allocated once at boot and never freed. The
+// firmware places them in PSRAM when the board has it (src/main.cpp); the
+// native tests provide a plain calloc() version. Memory comes back zeroed.
+void* allocLargeTable(size_t bytes, bool* inPsram = nullptr);
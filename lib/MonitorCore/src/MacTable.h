@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "HashBytes.h"
+#include "ObjectPool.h"
+
+const uint16_t MAC_TABLE_NIL = 0xFFFF;
+
+// Fixed-capacity table of per-device entries keyed by MAC address. Entries
+// come from an ObjectPool, are found through a linear-probing index and sit
+// on a last-seen list (oldest at head), so lookup, insert, touch and
+// evicting the stalest entry are all O(1).
+// T needs: uint8_t addr[6]; uint16_t home, prev, next.
+template <typename T>
+struct MacTable {
+  ObjectPool<T> pool;
+  uint16_t* index     = nullptr;
+  uint16_t  indexMask = 0;
+  uint16_t  head      = MAC_TABLE_NIL;
+  uint16_t  tail      = MAC_TABLE_NIL;
+
+  // The index is sized to a power of two at least twice the capacity
+  bool begin(uint16_t capacity) {
+    if (!pool.begin(capacity)) return false;
+    uint16_t indexSize = 1;
+    while (indexSize < capacity * 2) indexSize <<= 1;
+    index = (uint16_t*)allocLargeTable(sizeof(uint16_t) * indexSize);
+    if (!index) return false;
+    indexMask = indexSize - 1;
+    for (uint16_t i = 0; i < indexSize; ++i) index[i] = MAC_TABLE_NIL;
+    return true;
+  }
+
+  bool ready() const { return index != nullptr; }
+  uint16_t size() const { return pool.inUse(); }
+  bool full() const { return pool.freeCount == 0; }
+
+  T* find(const uint8_t addr[6]) {
+    uint16_t pos = findPos(addr, homeOf(addr));
+    return index[pos] == MAC_TABLE_NIL ? nullptr : &pool.slots[index[pos]];
+  }
+
+  // New zeroed entry at the newest end, or nullptr if the pool is full.
+  // The caller must have checked that addr is not present.
+  T* insert(const uint8_t addr[6]) {
+    T* e = pool.acquire();
+    if (!e) return nullptr;
+    uint16_t id = e - pool.slots;
+    memcpy(e->addr, addr, 6);
+    e->home = homeOf(addr);
+    index[findPos(addr, e->home)] = id;
+    linkTail(id);
+    return e;
+  }
+
+  // Mark as just seen
+  void touch(T* e) {
+    uint16_t id = e - pool.slots;
+    unlink(id);
+    linkTail(id);
+  }
+
+  void remove(T* e) {
+    uint16_t id = e - pool.slots;
+    unlink(id);
+    erasePos(findPos(e->addr, e->home));
+    pool.release(e);
+  }
+
+  T* oldest() { return head == MAC_TABLE_NIL ? nullptr : &pool.slots[head]; }
+  T* newest() { return tail == MAC_TABLE_NIL ? nullptr : &pool.slots[tail]; }
+  T* older(const T* e) { return e->prev == MAC_TABLE_NIL ? nullptr : &pool.slots[e->prev]; }
+
+ private:
+  uint16_t homeOf(const uint8_t addr[6]) const { return hashBytes(addr, 6) & indexMask; }
+
+  uint16_t findPos(const uint8_t addr[6], uint16_t pos) const {
+    while (index[pos] != MAC_TABLE_NIL && memcmp(pool.slots[index[pos]].addr, addr, 6) != 0) {
+      pos = (pos + 1) & indexMask;
+    }
+    return pos;
+  }
+
+  // Backward-shift deletion keeps probe chains intact without tombstones
+  void erasePos(uint16_t hole) {
+    index[hole] = MAC_TABLE_NIL;
+    for (uint16_t j = (hole + 1) & indexMask; index[j] != MAC_TABLE_NIL; j = (j + 1) & indexMask) {
+      uint16_t home = pool.slots[index[j]].home;
+      if (((j - home) & indexMask) >= ((j - hole) & indexMask)) {
+        index[hole] = index[j];
+        index[j] = MAC_TABLE_NIL;
+        hole = j;
+      }
+    }
+  }
+
+  void linkTail(uint16_t id) {
+    pool.slots[id].prev = tail;
+    pool.slots[id].next = MAC_TABLE_NIL;
+    if (tail != MAC_TABLE_NIL) pool.slots[tail].next = id;
+    else head = id;
+    tail = id;
+  }
+
+  void unlink(uint16_t id) {
+    T& e = pool.slots[id];
+    if (e.prev != MAC_TABLE_NIL) pool.slots[e.prev].next = e.next;
+    else head = e.next;
+    if (e.next != MAC_TABLE_NIL) pool.slots[e.next].prev = e.prev;
+    else tail = e.prev;
+  }
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "LargeTable.h"
+
+// Fixed-capacity pool for records that would otherwise be heap-allocated per
+// scan. Slots are zeroed on acquire; T must be a plain-old-data struct.
+template <typename T>
+struct ObjectPool {
+  T*        slots     = nullptr;
+  uint16_t* freeList  = nullptr;
+  uint16_t  capacity  = 0;
+  uint16_t  freeCount = 0;
+  uint16_t  peakInUse = 0;
+  bool      inPsram   = false;
+  uint32_t  acquires  = 0;
+  uint32_t  failures  = 0;
+
+  bool begin(uint16_t n) {
+    slots    = (T*)allocLargeTable(sizeof(T) * n, &inPsram);
+    freeList = (uint16_t*)allocLargeTable(sizeof(uint16_t) * n);
+    if (!slots || !freeList) return false;
+    capacity = freeCount = n;
+    for (uint16_t i = 0; i < n; ++i) freeList[i] = n - 1 - i;
+    return true;
+  }
+
+  T* acquire() {
+    if (freeCount == 0) {
+      failures++;
+      return nullptr;
+    }
+    T* p = &slots[freeList[--freeCount]];
+    memset((void*)p, 0, sizeof(T));
+    acquires++;
+    if (inUse() > peakInUse) peakInUse = inUse();
+    return p;
+  }
+
+  void release(T* p) {
+    if (!p) return;
+    freeList[freeCount++] = (uint16_t)(p - slots);
+  }
+
+  uint16_t inUse() const { return capacity - freeCount; }
+};
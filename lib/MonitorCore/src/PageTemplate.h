@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+
+// Page markup is written as one string with "{}" slots, e.g.
+//   html.render(TPL("<tr><td class='label'>RSSI</td><td>{} dBm</td></tr>"), rssi);
+// TPL splits it at compile time into static segments (pointers into the
+// literal, so the bytes stay in flash with their lengths already known)
+// and render() interleaves them with the typed values. The number of
+// arguments is checked against the number of slots when compiling.
+struct TemplateSegment {
+  const char* text;
+  size_t      length;
+};
+
+template <size_t Slots>
+struct PageTemplate {
+  TemplateSegment segments[Slots + 1];
+  size_t          staticBytes;
+};
+
+const size_t TEMPLATE_NO_SLOT = (size_t)-1;
+
+constexpr bool isTemplateSlot(const char* s, size_t i) { return s[i] == '{' && s[i + 1] == '}'; }
+
+constexpr size_t firstOf(size_t a, size_t b) { return a != TEMPLATE_NO_SLOT ? a : b; }
+
+// The searches split the range in halves so constexpr recursion depth
+// grows with log(length), not length.
+constexpr size_t firstTemplateSlot(const char* s, size_t lo, size_t hi) {
+  return hi - lo <= 1
+      ? (hi > lo && isTemplateSlot(s, lo) ? lo : TEMPLATE_NO_SLOT)
+      : firstOf(firstTemplateSlot(s, lo, lo + (hi - lo) / 2), firstTemplateSlot(s, lo + (hi - lo) / 2, hi));
+}
+
+constexpr size_t countTemplateSlots(const char* s, size_t lo, size_t hi) {
+  return hi - lo <= 1
+      ? (hi > lo && isTemplateSlot(s, lo) ? 1 : 0)
+      : countTemplateSlots(s, lo, lo + (hi - lo) / 2) + countTemplateSlots(s, lo + (hi - lo) / 2, hi);
+}
+
+template <size_t N>
+constexpr size_t templateSlots(const char (&s)[N]) { return countTemplateSlots(s, 0, N - 1); }
+
+constexpr size_t templateSlotAt(const char* s, size_t len, size_t k) {
+  return firstTemplateSlot(s, k == 0 ? 0 : templateSlotAt(s, len, k - 1) + 2, len);
+}
+
+constexpr TemplateSegment templateSegment(const char* s, size_t len, size_t k, size_t slots) {
+  return TemplateSegment{ s + (k == 0 ? 0 : templateSlotAt(s, len, k - 1) + 2),
+                          (k == slots ? len : templateSlotAt(s, len, k)) -
+                              (k == 0 ? 0 : templateSlotAt(s, len, k - 1) + 2) };
+}
+
+template <size_t... I> struct TemplateIndices {};
+template <size_t N, size_t... I> struct MakeTemplateIndices : MakeTemplateIndices<N - 1, N - 1, I...> {};
+template <size_t... I> struct MakeTemplateIndices<0, I...> { typedef TemplateIndices<I...> type; };
+
+template <size_t Slots, size_t... I>
+constexpr PageTemplate<Slots> buildTemplate(const char* s, size_t len, TemplateIndices<I...>) {
+  return PageTemplate<Slots>{ { templateSegment(s, len, I, Slots)... }, len - 2 * Slots };
+}
+
+template <size_t Slots, size_t N>
+constexpr PageTemplate<Slots> parseTemplate(const char (&s)[N]) {
+  return buildTemplate<Slots>(s, N - 1, typename MakeTemplateIndices<Slots + 1>::type());
+}
+
+// The static constexpr local forces the parse to happen at compile time;
+// each use site gets its own template in rodata.
+#define TPL(text)                                                                  \
+  ([]() -> const PageTemplate<templateSlots(text)>& {                              \
+    static constexpr PageTemplate<templateSlots(text)> tpl =                       \
+        parseTemplate<templateSlots(text)>(text);                                  \
+    return tpl;                                                                    \
+  }())
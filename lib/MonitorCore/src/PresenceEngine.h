@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "MacTable.h"
+
+// A session opens on a strong sighting and is only kept alive by sightings
+// above a weaker threshold, so devices at the edge of range don't flap.
+const int8_t        PRESENCE_ENTER_RSSI   = -80;
+const int8_t        PRESENCE_STAY_RSSI    = -90;
+const unsigned long PRESENCE_EXIT_MS      = 90000UL;
+const uint16_t      PRESENCE_MAX_SESSIONS = 256;
+const int           PRESENCE_EVENT_LOG    = 32;
+const int           DWELL_BINS            = 10;
+
+// Upper bound of each dwell bin in seconds; the last bin is open-ended
+const uint32_t DWELL_BIN_LIMIT_S[DWELL_BINS] = { 60, 120, 300, 600, 1200, 1800, 3600, 7200, 14400, 0xFFFFFFFFu };
+
+struct PresenceSession {
+  uint8_t       addr[6];
+  int8_t        lastRssi;
+  uint16_t      home;
+  uint16_t      prev;
+  uint16_t      next;
+  unsigned long enterMs;
+  unsigned long lastSeenMs;
+};
+
+enum PresenceEventType : uint8_t { PRESENCE_ENTER, PRESENCE_EXIT };
+
+struct PresenceEvent {
+  uint8_t       addr[6];
+  uint8_t       type;
+  unsigned long atMs;
+  uint32_t      dwellMs;  // exit events only
+};
+
+struct HourProfile {
+  uint64_t occupancyMs;  // integral of active sessions over time
+  uint64_t coveredMs;
+  uint16_t peak;
+};
+
+// Turns the stream of BLE sightings into enter/exit sessions. Every update is
+// O(1), and since sessions are kept in last-seen order expiry only ever looks
+// at the oldest one. Pages and the API read the aggregates below and never
+// walk the sessions.
+struct PresenceEngine {
+  MacTable<PresenceSession> sessions;
+
+  uint16_t active     = 0;
+  uint16_t peakActive = 0;
+  uint32_t version    = 0;  // bumped on every enter/exit
+  uint32_t observations = 0;
+  uint32_t enters = 0;
+  uint32_t exits  = 0;
+  uint32_t dropped = 0;     // strong sightings with no free session
+  uint64_t totalDwellMs = 0;
+  uint32_t dwellHistogram[DWELL_BINS] = {};
+  HourProfile hourly[24] = {};
+  PresenceEvent events[PRESENCE_EVENT_LOG];
+  uint32_t eventCount = 0;  // ring position is eventCount % PRESENCE_EVENT_LOG
+  unsigned long lastIntegrateMs = 0;
+
+  bool begin() { return sessions.begin(PRESENCE_MAX_SESSIONS); }
+
+  // hourSlot is the hour-of-day bucket that nowMs falls in
+  void observe(const uint8_t addr[6], int8_t rssi, unsigned long nowMs, uint8_t hourSlot) {
+    if (!sessions.ready()) return;
+    observations++;
+    expire(nowMs, hourSlot);
+
+    PresenceSession* s = sessions.find(addr);
+    if (s) {
+      if (rssi < PRESENCE_STAY_RSSI) return;
+      s->lastSeenMs = nowMs;
+      s->lastRssi = rssi;
+      sessions.touch(s);
+      return;
+    }
+
+    if (rssi < PRESENCE_ENTER_RSSI) return;
+    integrate(nowMs, hourSlot);
+    s = sessions.insert(addr);
+    if (!s) {
+      dropped++;
+      return;
+    }
+    s->lastRssi   = rssi;
+    s->enterMs    = nowMs;
+    s->lastSeenMs = nowMs;
+
+    active++;
+    if (active > peakActive) peakActive = active;
+    if (active > hourly[hourSlot].peak) hourly[hourSlot].peak = active;
+    enters++;
+    version++;
+    logEvent(addr, PRESENCE_ENTER, nowMs, 0);
+  }
+
+  // Called periodically so sessions close even when nothing is being observed
+  void tick(unsigned long nowMs, uint8_t hourSlot) {
+    if (!sessions.ready()) return;
+    expire(nowMs, hourSlot);
+    integrate(nowMs, hourSlot);
+  }
+
+  float averageOccupancy(uint8_t hour) const {
+    const HourProfile& h = hourly[hour];
+    return h.coveredMs ? (float)((double)h.occupancyMs / (double)h.coveredMs) : 0.0f;
+  }
+
+  uint32_t meanDwellSeconds() const {
+    return exits ? (uint32_t)(totalDwellMs / exits / 1000) : 0;
+  }
+
+  const PresenceEvent* recentEvent(uint32_t age) const {
+    if (age >= eventCount || age >= (uint32_t)PRESENCE_EVENT_LOG) return nullptr;
+    return &events[(eventCount - 1 - age) % PRESENCE_EVENT_LOG];
+  }
+
+ private:
+  void expire(unsigned long nowMs, uint8_t hourSlot) {
+    PresenceSession* s;
+    while ((s = sessions.oldest()) != nullptr && nowMs - s->lastSeenMs > PRESENCE_EXIT_MS) {
+      integrate(nowMs, hourSlot);
+      uint32_t dwellMs = s->lastSeenMs - s->enterMs;
+
+      uint32_t dwellS = dwellMs / 1000;
+      int bin = 0;
+      while (bin < DWELL_BINS - 1 && dwellS >= DWELL_BIN_LIMIT_S[bin]) bin++;
+      dwellHistogram[bin]++;
+      totalDwellMs += dwellMs;
+
+      logEvent(s->addr, PRESENCE_EXIT, nowMs, dwellMs);
+      sessions.remove(s);
+      active--;
+      exits++;
+      version++;
+    }
+  }
+
+  void integrate(unsigned long nowMs, uint8_t hourSlot) {
+    // Sightings drained from the BLE ring can be stamped before the last tick
+    if ((long)(nowMs - lastIntegrateMs) <= 0) return;
+    uint32_t dt = nowMs - lastIntegrateMs;
+    lastIntegrateMs = nowMs;
+    HourProfile& h = hourly[hourSlot];
+    h.coveredMs   += dt;
+    h.occupancyMs += (uint64_t)active * dt;
+  }
+
+  void logEvent(const uint8_t addr[6], uint8_t type, unsigned long atMs, uint32_t dwellMs) {
+    PresenceEvent& e = events[eventCount % PRESENCE_EVENT_LOG];
+    memcpy(e.addr, addr, 6);
+    e.type    = type;
+    e.atMs    = atMs;
+    e.dwellMs = dwellMs;
+    eventCount++;
+  }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#include "LargeTable.h"
+
+// Lock-free single-producer/single-consumer ring. The producer is the BLE
+// host task's advert callback, the consumer is bleIngestTask; neither side
+// ever blocks. Indices run freely, so head - tail is the fill level.
+template <typename T>
+struct SpscRing {
+  T*       slots = nullptr;
+  uint32_t mask  = 0;
+  std::atomic<uint32_t> head{0};     // next slot to write (producer only)
+  std::atomic<uint32_t> tail{0};     // next slot to read (consumer only)
+  std::atomic<uint32_t> pushed{0};
+  std::atomic<uint32_t> dropped{0};  // ring was full
+  uint32_t highWater = 0;            // deepest backlog seen by the consumer
+  bool     inPsram   = false;
+
+  // capacity must be a power of two
+  bool begin(uint32_t capacity) {
+    slots = (T*)allocLargeTable(sizeof(T) * capacity, &inPsram);
+    if (!slots) return false;
+    mask = capacity - 1;
+    return true;
+  }
+
+  uint32_t capacity() const { return slots ? mask + 1 : 0; }
+
+  // Producer: slot to fill in place, or nullptr (counted as a drop) if full
+  T* reserve() {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (!slots || h - tail.load(std::memory_order_acquire) > mask) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &slots[h & mask];
+  }
+
+  // Producer: publish the slot returned by reserve()
+  void commit() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    pushed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Consumer: readable slots, starting at peek(0)
+  uint32_t available() {
+    uint32_t n = head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+    if (n > highWater) highWater = n;
+    return n;
+  }
+
+  const T& peek(uint32_t i) const {
+    return slots[(tail.load(std::memory_order_relaxed) + i) & mask];
+  }
+
+  // Consumer: hand n slots back to the producer
+  void consume(uint32_t n) {
+    tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "LargeTable.h"
+
+// Counting distinct devices over hours with an address set grows without
+// bound in a busy venue. A HyperLogLog sketch estimates the distinct count
+// of a hashed stream in a fixed 2^p registers (±1.04/sqrt(2^p)), and two
+// sketches merge by taking the register-wise max. Without PSRAM the sketches
+// live in internal RAM next to the radio stacks, so p drops to 7 (~9%).
+#ifdef BOARD_HAS_PSRAM
+const uint8_t  HLL_PRECISION = 8;
+#else
+const uint8_t  HLL_PRECISION = 7;
+#endif
+const uint16_t HLL_REGISTERS = 1 << HLL_PRECISION;
+const uint8_t  HLL_REGISTER_BITS = 6;  // ranks never exceed 33 - HLL_PRECISION
+
+struct HllSketch {
+  // 6-bit registers packed LSB first, plus a spare byte so any register can
+  // be read as a 16-bit window
+  uint8_t packed[HLL_REGISTERS * HLL_REGISTER_BITS / 8 + 1];
+
+  void clear() { memset(packed, 0, sizeof(packed)); }
+
+  uint8_t get(uint16_t i) const {
+    uint16_t bit = i * HLL_REGISTER_BITS;
+    uint16_t w   = packed[bit >> 3] | (packed[(bit >> 3) + 1] << 8);
+    return (w >> (bit & 7)) & 0x3F;
+  }
+
+  void set(uint16_t i, uint8_t v) {
+    uint16_t bit = i * HLL_REGISTER_BITS;
+    uint16_t at  = bit >> 3;
+    uint16_t w   = packed[at] | (packed[at + 1] << 8);
+    w = (w & ~(0x3F << (bit & 7))) | (v << (bit & 7));
+    packed[at]     = (uint8_t)w;
+    packed[at + 1] = (uint8_t)(w >> 8);
+  }
+
+  // hash must be well mixed (hashBytes is)
+  void add(uint32_t hash) {
+    uint32_t rest = hash << HLL_PRECISION;
+    uint8_t  rank = rest ? __builtin_clz(rest) + 1 : 32 - HLL_PRECISION + 1;
+    uint16_t i    = hash >> (32 - HLL_PRECISION);
+    if (rank > get(i)) set(i, rank);
+  }
+
+  void merge(const HllSketch& other) {
+    for (uint16_t i = 0; i < HLL_REGISTERS; ++i) {
+      uint8_t v = other.get(i);
+      if (v > get(i)) set(i, v);
+    }
+  }
+
+  uint32_t estimate() const {
+    float    sum   = 0.0f;
+    uint16_t zeros = 0;
+    for (uint16_t i = 0; i < HLL_REGISTERS; ++i) {
+      uint8_t v = get(i);
+      sum += ldexpf(1.0f, -v);
+      if (v == 0) zeros++;
+    }
+    const float m = HLL_REGISTERS;
+    float e = 0.7213f / (1.0f + 1.079f / m) * m * m / sum;
+    if (e <= 2.5f * m && zeros) e = m * logf(m / zeros);  // small-range correction
+    return (uint32_t)(e + 0.5f);
+  }
+};
+
+// Each stream keeps rings of sketches on uptime boundaries; a window is
+// answered by merging the buckets it spans. A window of k bucket spans needs
+// k + 1 buckets (the current one is partial), and the rings are sized so
+// 5 min, 1 h, 24 h and 7 d each fit on a level at most 1/5 of the window.
+enum UniqueLevel : uint8_t { UNIQUE_MINUTE, UNIQUE_FIVE_MINUTES, UNIQUE_HOUR, UNIQUE_DAY, UNIQUE_LEVELS };
+
+const uint64_t UNIQUE_LEVEL_SPAN_MS[UNIQUE_LEVELS] = { 60000ULL, 300000ULL, 3600000ULL, 86400000ULL };
+const uint8_t  UNIQUE_LEVEL_BUCKETS[UNIQUE_LEVELS] = { 6, 13, 25, 8 };
+const uint8_t  UNIQUE_LEVEL_OFFSET[UNIQUE_LEVELS]  = { 0, 6, 19, 44 };
+const uint8_t  UNIQUE_TOTAL_BUCKETS = 52;
+
+// Longest window the day ring can answer
+const uint64_t UNIQUE_MAX_WINDOW_MS =
+    UNIQUE_LEVEL_SPAN_MS[UNIQUE_DAY] * (UNIQUE_LEVEL_BUCKETS[UNIQUE_DAY] - 1);
+
+struct UniqueCounter {
+  HllSketch* buckets = nullptr;
+  uint32_t   period[UNIQUE_TOTAL_BUCKETS] = {};  // uptime period held + 1; 0 = empty
+  uint32_t   added = 0;
+
+  bool begin() {
+    buckets = (HllSketch*)allocLargeTable(sizeof(HllSketch) * UNIQUE_TOTAL_BUCKETS);
+    return buckets != nullptr;
+  }
+
+  // nowMs is a non-wrapping uptime clock (the firmware uses esp_timer)
+  void add(uint32_t hash, uint64_t nowMs) {
+    if (!buckets) return;
+    for (uint8_t level = 0; level < UNIQUE_LEVELS; ++level) {
+      uint32_t p = (uint32_t)(nowMs / UNIQUE_LEVEL_SPAN_MS[level]) + 1;
+      uint8_t  slot = UNIQUE_LEVEL_OFFSET[level] + p % UNIQUE_LEVEL_BUCKETS[level];
+      if (period[slot] != p) {
+        buckets[slot].clear();
+        period[slot] = p;
+      }
+      buckets[slot].add(hash);
+    }
+    added++;
+  }
+
+  // Distinct items over the last windowMs (capped at UNIQUE_MAX_WINDOW_MS),
+  // from the finest level that holds it. Buckets are whole, so the span
+  // actually merged runs from the start of the bucket holding now - windowMs
+  // up to now: at least the window (or all of uptime), less than one bucket
+  // more. That span is stored in *coveredMs when given.
+  uint32_t uniqueWithin(uint64_t windowMs, uint64_t nowMs, uint64_t* coveredMs = nullptr) const {
+    if (windowMs > UNIQUE_MAX_WINDOW_MS) windowMs = UNIQUE_MAX_WINDOW_MS;
+    uint8_t level = UNIQUE_MINUTE;
+    while (level < UNIQUE_DAY &&
+           windowMs > UNIQUE_LEVEL_SPAN_MS[level] * (UNIQUE_LEVEL_BUCKETS[level] - 1)) level++;
+
+    uint64_t span    = UNIQUE_LEVEL_SPAN_MS[level];
+    uint64_t startMs = windowMs < nowMs ? (nowMs - windowMs) / span * span : 0;
+    if (coveredMs) *coveredMs = nowMs - startMs;
+    if (!buckets) return 0;
+
+    HllSketch merged;
+    merged.clear();
+    uint32_t last = (uint32_t)(nowMs / span) + 1;
+    for (uint32_t p = (uint32_t)(startMs / span) + 1; p <= last; ++p) {
+      uint8_t slot = UNIQUE_LEVEL_OFFSET[level] + p % UNIQUE_LEVEL_BUCKETS[level];
+      if (period[slot] == p) merged.merge(buckets[slot]);
+    }
+    return merged.estimate();
+  }
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+struct WifiApRecord {
+  uint8_t bssid[6];
+  int8_t  rssi;
+  uint8_t channel;
+  uint8_t authMode;
+  char    ssid[33];
+};
+
+enum WifiChangeType : uint8_t {
+  WIFI_AP_ADDED,
+  WIFI_AP_REMOVED,
+  WIFI_AP_SECURITY_CHANGED,
+  WIFI_AP_CHANNEL_CHANGED,
+};
+
+const uint8_t WIFI_NO_INDEX = 0xFF;
+
+// Sort order[] (indices into aps[]) by BSSID. Insertion sort: count <= 48
+// and scans come back mostly in the same order.
+inline void sortByBssid(const WifiApRecord* aps, uint8_t* order, uint16_t count) {
+  for (uint16_t i = 0; i < count; ++i) {
+    uint8_t v = i;
+    int j = i - 1;
+    while (j >= 0 && memcmp(aps[order[j]].bssid, aps[v].bssid, 6) > 0) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = v;
+  }
+}
+
+// Merge-join two BSSID-ordered scans in O(n + m). onChange(type, prevIdx,
+// curIdx) is called in BSSID order for every BSSID that disappeared or
+// appeared (the missing side is WIFI_NO_INDEX), and for every BSSID in
+// both whose security or channel changed; if both changed, security is
+// reported first. Indices are into the respective aps[] arrays.
+template <typename OnChange>
+void diffByBssid(const WifiApRecord* prevAps, const uint8_t* prevOrder, uint16_t n,
+                 const WifiApRecord* curAps, const uint8_t* curOrder, uint16_t m, OnChange onChange) {
+  uint16_t i = 0, j = 0;
+  while (i < n || j < m) {
+    int cmp;
+    if (i >= n)      cmp = 1;
+    else if (j >= m) cmp = -1;
+    else cmp = memcmp(prevAps[prevOrder[i]].bssid, curAps[curOrder[j]].bssid, 6);
+
+    if (cmp < 0) {
+      onChange(WIFI_AP_REMOVED, prevOrder[i++], WIFI_NO_INDEX);
+    } else if (cmp > 0) {
+      onChange(WIFI_AP_ADDED, WIFI_NO_INDEX, curOrder[j++]);
+    } else {
+      const WifiApRecord& was = prevAps[prevOrder[i]];
+      const WifiApRecord& now = curAps[curOrder[j]];
+      if (was.authMode != now.authMode) onChange(WIFI_AP_SECURITY_CHANGED, prevOrder[i], curOrder[j]);
+      if (was.channel != now.channel)   onChange(WIFI_AP_CHANNEL_CHANGED, prevOrder[i], curOrder[j]);
+      i++;
+      j++;
+    }
+  }
+}
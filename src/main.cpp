@@ -3,6 +3,20 @@
 #include <WebServer.h>
 #include <BLEDevice.h>
 #include <BLEScan.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+
+#include <ChannelPlan.h>
+#include <HashBytes.h>
+#include <LargeTable.h>
+#include <MacTable.h>
+#include <ObjectPool.h>
+#include <PageTemplate.h>
+#include <PresenceEngine.h>
+#include <SpscRing.h>
+#include <UniqueCounter.h>
+#include <WifiDiff.h>
 
 const char* apSSID = "ESP32-Monitor";
 const char* apPASS = "12345678";
@@ -49,55 +63,1308 @@ void recordTemperatureSample(float tC) {
   tempHistory[tempHistoryCount - 1] = tC;
 }
 
-// ---------- Helpers ----------
+// ---------- Memory: PSRAM-aware tables, request arena, object pools ----------
+
+// Long-lived tables are allocated once at boot (see LargeTable.h). Boards
+// with PSRAM get them placed there automatically so the internal heap is
+// left to Wi-Fi/BLE. In internal RAM a table is refused rather than leave
+// less than LARGE_TABLE_INTERNAL_RESERVE for lwIP, the web server and the
+// radio stacks' runtime buffers; its feature then reports itself missing.
+const size_t LARGE_TABLE_INTERNAL_RESERVE = 48 * 1024;
+
+size_t   largeTableBytesPsram    = 0;
+size_t   largeTableBytesInternal = 0;
+uint32_t largeTablesRefused      = 0;
+
+void* allocLargeTable(size_t bytes, bool* inPsram) {
+  void* p = nullptr;
+  bool psram = false;
+  if (psramFound()) {
+    p = heap_caps_calloc(1, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    psram = (p != nullptr);
+  }
+  if (!p) {
+    if (heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) < bytes + LARGE_TABLE_INTERNAL_RESERVE) {
+      largeTablesRefused++;
+    } else {
+      p = heap_caps_calloc(1, bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+  }
+  if (p) {
+    if (psram) largeTableBytesPsram += bytes;
+    else       largeTableBytesInternal += bytes;
+  }
+  if (inPsram) *inPsram = psram;
+  return p;
+}
 
-String formatBytes(size_t bytes) {
-  const char* sizes[] = { "B", "KB", "MB" };
-  int order = 0;
-  double fBytes = bytes;
+// Bump allocator for per-request scratch (page bodies, formatting). It is
+// reset before every request, so nothing handed out may outlive a handler.
+struct RequestArena {
+  uint8_t* base      = nullptr;
+  size_t   capacity  = 0;
+  size_t   used      = 0;
+  size_t   highWater = 0;
+  bool     inPsram   = false;
+
+  uint32_t allocations     = 0;  // since boot
+  uint32_t lastRequestAllocs = 0;
+  uint32_t requestAllocs   = 0;
+  uint32_t resets          = 0;
+  uint32_t spills          = 0;  // buffers that had to fall back to the heap
+
+  bool begin(size_t bytes) {
+    base = (uint8_t*)allocLargeTable(bytes, &inPsram);
+    capacity = base ? bytes : 0;
+    return base != nullptr;
+  }
 
-  while (fBytes >= 1024 && order < 2) {
-    order++;
-    fBytes = fBytes / 1024.0;
+  void* alloc(size_t bytes) {
+    size_t start = (used + 3) & ~(size_t)3;
+    if (!base || start + bytes > capacity) return nullptr;
+    used = start + bytes;
+    if (used > highWater) highWater = used;
+    allocations++;
+    requestAllocs++;
+    return base + start;
   }
 
-  char buffer[32];
-  snprintf(buffer, sizeof(buffer), "%.2f %s", fBytes, sizes[order]);
-  return String(buffer);
-}
+  // Largest size the most recent allocation can grow to in place; 0 if
+  // anything came after it.
+  size_t room(const void* p, size_t oldBytes) const {
+    if ((const uint8_t*)p + oldBytes != base + used) return 0;
+    return capacity - ((const uint8_t*)p - base);
+  }
+
+  // Grow the most recent allocation in place; fails if anything came after it.
+  bool extend(void* p, size_t oldBytes, size_t newBytes) {
+    if ((uint8_t*)p + oldBytes != base + used) return false;
+    size_t start = (uint8_t*)p - base;
+    if (start + newBytes > capacity) return false;
+    used = start + newBytes;
+    if (used > highWater) highWater = used;
+    return true;
+  }
 
-String getUptimeString() {
-  unsigned long ms = millis();
+  void reset() {
+    if (used == 0 && requestAllocs == 0) return;
+    lastRequestAllocs = requestAllocs;
+    requestAllocs = 0;
+    used = 0;
+    resets++;
+  }
+};
+
+RequestArena requestArena;
+
+// Internal size fits the largest render, a /wifi page of about 19 KB;
+// anything bigger spills to the heap and shows up in spills.
+const size_t REQUEST_ARENA_INTERNAL = 20 * 1024;
+const size_t REQUEST_ARENA_PSRAM    = 128 * 1024;
+
+// Value wrappers so page builders can append formatted numbers without
+// building temporary Strings.
+struct FixedPoint { float value; uint8_t decimals; };
+struct ByteCount  { size_t bytes; };
+struct MacText    { const uint8_t* bytes; uint8_t octets; bool upper; };
+struct UptimeStamp { unsigned long ms; };
+struct HtmlText   { const char* text; };
+
+FixedPoint fixed(float value, uint8_t decimals) { return FixedPoint{ value, decimals }; }
+ByteCount  asBytes(size_t bytes)                { return ByteCount{ bytes }; }
+MacText    bssidText(const uint8_t* b)          { return MacText{ b, 6, true }; }
+MacText    ouiText(const uint8_t* b)            { return MacText{ b, 3, true }; }
+MacText    bleAddrText(const uint8_t* b)        { return MacText{ b, 6, false }; }
+UptimeStamp uptimeAt(unsigned long ms)          { return UptimeStamp{ ms }; }
+// SSIDs and BLE names are chosen by whoever runs the radio; escape them
+HtmlText   htmlText(const char* s)              { return HtmlText{ s }; }
+
+void formatUptimeMs(unsigned long ms, char* buf, size_t len) {
   unsigned long seconds = ms / 1000;
   unsigned long s = seconds % 60;
   unsigned long minutes = (seconds / 60) % 60;
   unsigned long hours = (seconds / 3600) % 24;
   unsigned long days = seconds / 86400;
 
-  char buf[64];
-  snprintf(buf, sizeof(buf), "%lu d %02lu:%02lu:%02lu", days, hours, minutes, s);
-  return String(buf);
+  snprintf(buf, len, "%lu d %02lu:%02lu:%02lu", days, hours, minutes, s);
+}
+
+// Growable text buffer carved out of the request arena. Page builders append
+// to it instead of concatenating Strings, so a request leaves no heap holes.
+class PageBuffer {
+ public:
+  explicit PageBuffer(size_t initialCapacity = 2048) { reserve(initialCapacity); }
+  ~PageBuffer() { if (spilled) free(buf); }
+  PageBuffer(const PageBuffer&) = delete;
+  PageBuffer& operator=(const PageBuffer&) = delete;
+
+  void append() {}
+
+  template <typename T, typename... Rest>
+  void append(const T& first, const Rest&... rest) {
+    appendOne(first);
+    append(rest...);
+  }
+
+  // Fill a TPL (PageTemplate.h). Slot values are formatted by the same
+  // overloads append() uses. The static size is known, so the buffer grows
+  // at most once per template.
+  template <size_t Slots, typename... Args>
+  void render(const PageTemplate<Slots>& tpl, const Args&... args) {
+    static_assert(sizeof...(Args) == Slots, "template slots and arguments differ");
+    reserve(len + tpl.staticBytes + Slots * 8 + 1);
+    renderSegments(tpl.segments, args...);
+  }
+
+  const char* c_str() const { return buf ? buf : ""; }
+  size_t length() const { return len; }
+
+ private:
+  void renderSegments(const TemplateSegment* seg) { write(seg->text, seg->length); }
+
+  template <typename T, typename... Rest>
+  void renderSegments(const TemplateSegment* seg, const T& value, const Rest&... rest) {
+    write(seg->text, seg->length);
+    appendOne(value);
+    renderSegments(seg + 1, rest...);
+  }
+
+  void appendOne(const char* s) { if (s) write(s, strlen(s)); }
+  void appendOne(const __FlashStringHelper* s) {
+    PGM_P p = reinterpret_cast<PGM_P>(s);
+    write(p, strlen_P(p));
+  }
+  void appendOne(const String& s) { write(s.c_str(), s.length()); }
+  void appendOne(char c) { write(&c, 1); }
+  void appendOne(int v)           { char t[12]; writeFormatted(t, snprintf(t, sizeof(t), "%d", v)); }
+  void appendOne(unsigned v)      { char t[12]; writeFormatted(t, snprintf(t, sizeof(t), "%u", v)); }
+  void appendOne(long v)          { char t[24]; writeFormatted(t, snprintf(t, sizeof(t), "%ld", v)); }
+  void appendOne(unsigned long v) { char t[24]; writeFormatted(t, snprintf(t, sizeof(t), "%lu", v)); }
+  void appendOne(double v)        { appendOne(fixed((float)v, 2)); }
+  void appendOne(const FixedPoint& f) {
+    char t[24];
+    writeFormatted(t, snprintf(t, sizeof(t), "%.*f", (int)f.decimals, (double)f.value));
+  }
+  void appendOne(const ByteCount& b) {
+    const char* sizes[] = { "B", "KB", "MB" };
+    int order = 0;
+    double fBytes = b.bytes;
+    while (fBytes >= 1024 && order < 2) {
+      order++;
+      fBytes = fBytes / 1024.0;
+    }
+    char t[32];
+    writeFormatted(t, snprintf(t, sizeof(t), "%.2f %s", fBytes, sizes[order]));
+  }
+  void appendOne(const UptimeStamp& u) {
+    char t[24];
+    formatUptimeMs(u.ms, t, sizeof(t));
+    appendOne(t);
+  }
+  void appendOne(const HtmlText& h) {
+    if (!h.text) return;
+    const char* run = h.text;
+    for (const char* c = h.text; *c; ++c) {
+      const char* entity;
+      switch (*c) {
+        case '&':  entity = "&amp;";  break;
+        case '<':  entity = "&lt;";   break;
+        case '>':  entity = "&gt;";   break;
+        case '"':  entity = "&quot;"; break;
+        case '\'': entity = "&#39;";  break;
+        default:   continue;
+      }
+      write(run, c - run);
+      appendOne(entity);
+      run = c + 1;
+    }
+    appendOne(run);
+  }
+  void appendOne(const MacText& m) {
+    const char* fmt = m.upper ? "%02X" : "%02x";
+    char t[4];
+    for (uint8_t i = 0; i < m.octets; ++i) {
+      if (i) write(":", 1);
+      writeFormatted(t, snprintf(t, sizeof(t), fmt, m.bytes[i]));
+    }
+  }
+
+  // snprintf returns the untruncated length; never copy past the buffer
+  template <size_t N>
+  void writeFormatted(const char (&t)[N], int n) { write(t, n < (int)N ? n : (int)N - 1); }
+
+  void write(const char* s, int n) {
+    if (n <= 0) return;
+    if (!reserve(len + n + 1)) return;
+    memcpy(buf + len, s, n);
+    len += n;
+    buf[len] = '\0';
+  }
+
+  bool reserve(size_t need) {
+    if (need <= cap) return true;
+    size_t newCap = cap ? cap : 256;
+    while (newCap < need) newCap *= 2;
+
+    char* p = nullptr;
+    if (!spilled) {
+      // Doubling can overshoot the arena; the rest of it will do if enough
+      size_t room = buf ? requestArena.room(buf, cap) : 0;
+      if (newCap > room && room >= need) newCap = room;
+      if (buf && requestArena.extend(buf, cap, newCap)) {
+        cap = newCap;
+        return true;
+      }
+      p = (char*)requestArena.alloc(newCap);
+      if (!p) {
+        // Arena exhausted: move to the heap for the rest of this request
+        p = (char*)malloc(newCap);
+        if (!p) return false;
+        spilled = true;
+        requestArena.spills++;
+      }
+      if (len) memcpy(p, buf, len + 1);
+    } else {
+      p = (char*)realloc(buf, newCap);
+      if (!p) return false;
+    }
+    if (!len) p[0] = '\0';
+    buf = p;
+    cap = newCap;
+    return true;
+  }
+
+  char*  buf     = nullptr;
+  size_t len     = 0;
+  size_t cap     = 0;
+  bool   spilled = false;
+};
+
+// Lowest contiguous block seen since boot; a falling value means fragmentation
+size_t maxAllocHeapLow = 0;
+
+static const unsigned long HEAP_SAMPLE_INTERVAL_MS = 1000;
+unsigned long lastHeapSampleMs = 0;
+
+// Walking the heap for the largest free block is not free; once a second is
+// plenty to catch the trend
+void sampleHeapFragmentation() {
+  unsigned long now = millis();
+  if (maxAllocHeapLow != 0 && now - lastHeapSampleMs < HEAP_SAMPLE_INTERVAL_MS) return;
+  lastHeapSampleMs = now;
+  size_t maxAlloc = ESP.getMaxAllocHeap();
+  if (maxAllocHeapLow == 0 || maxAlloc < maxAllocHeapLow) maxAllocHeapLow = maxAlloc;
+}
+
+// ---------- Helpers ----------
+
+void formatUptime(char* buf, size_t len) {
+  formatUptimeMs(millis(), buf, len);
 }
 
 bool isSerialActiveRecently() {
   return (millis() - lastSerialActivity) < 10000UL; // 10 seconds
 }
 
+// Case-insensitive substring test for the name/SSID heuristics
+bool containsNoCase(const char* haystack, const char* needle) {
+  char lower[40];
+  size_t i = 0;
+  for (; haystack[i] && i < sizeof(lower) - 1; ++i) lower[i] = (char)tolower((unsigned char)haystack[i]);
+  lower[i] = '\0';
+  return strstr(lower, needle) != nullptr;
+}
+
+// Parse "aa:bb:cc:dd:ee:ff" (either case) into 6 bytes
+bool parseMac(const String& text, uint8_t out[6]) {
+  unsigned int b[6];
+  if (sscanf(text.c_str(), "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) return false;
+  for (int i = 0; i < 6; ++i) out[i] = (uint8_t)b[i];
+  return true;
+}
+
+// SSIDs are arbitrary bytes; escape what would break a JSON string
+void appendJsonEscaped(PageBuffer& json, const char* text) {
+  char esc[8];
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      json.append('\\', *c);
+    } else if ((uint8_t)*c < 0x20) {
+      snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)(uint8_t)*c);
+      json.append(esc);
+    } else {
+      json.append(*c);
+    }
+  }
+}
+
+// No RTC or NTP on this unit, so "hour of day" is hours since boot modulo 24
+uint8_t currentHourSlot() {
+  return (uint8_t)((esp_timer_get_time() / 3600000000LL) % 24);
+}
+
+// ---------- Presence & dwell-time analytics ----------
+
+// Sessions, dwell bins and hourly occupancy come from PresenceEngine.h;
+// the firmware feeds it BLE sightings and the uptime hour slot.
+const char* const DWELL_BIN_LABEL[DWELL_BINS] = { "&lt;1m", "1-2m", "2-5m", "5-10m", "10-20m", "20-30m",
+                                                  "30-60m", "1-2h", "2-4h", "&gt;4h" };
+
+PresenceEngine presence;
+
+// ---------- Unique-device sketches (HyperLogLog) ----------
+
+// Sketch buckets sit on uptime boundaries; esp_timer, unlike millis(),
+// does not wrap after 49 days
+uint64_t uniqueClockMs() { return esp_timer_get_time() / 1000; }
+
+// BLE streams are written by the ingest task under bleDataMutex; BSSIDs
+// only by the loop task.
+UniqueCounter uniqueBleAddrs;
+UniqueCounter uniqueBlePayloads;  // payload fingerprints survive address rotation
+UniqueCounter uniqueBssids;
+
+bool beginUniqueCounters() {
+  return uniqueBleAddrs.begin() && uniqueBlePayloads.begin() && uniqueBssids.begin();
+}
+
+// ---------- Scan snapshots ----------
+
+const uint16_t MAX_WIFI_APS    = 48;
+const uint16_t MAX_BLE_DEVICES = 64;
+
+struct WifiSnapshot {
+  uint32_t      version;
+  unsigned long takenMs;
+  uint16_t      count;
+  uint16_t      totalSeen;  // as reported by the driver, may exceed count
+  WifiApRecord  aps[MAX_WIFI_APS];
+  uint8_t       byBssid[MAX_WIFI_APS];  // indices into aps[], ascending BSSID
+};
+
+struct BleDeviceRecord {
+  uint8_t  addr[6];
+  int8_t   rssi;
+  int8_t   txPower;
+  bool     haveTxPower;
+  uint8_t  mfgLen;    // bytes kept in mfg[]
+  uint16_t mfgTotal;  // full manufacturer data length
+  uint8_t  mfg[16];
+  char     name[24];
+};
+
+struct BleSnapshot {
+  uint32_t        version;
+  unsigned long   takenMs;
+  uint16_t        count;
+  uint16_t        totalSeen;
+  BleDeviceRecord devices[MAX_BLE_DEVICES];
+};
+
+// Three Wi-Fi snapshots: the latest, the one before it (for change
+// detection) and one being filled.
+ObjectPool<WifiSnapshot> wifiSnapshotPool;
+ObjectPool<BleSnapshot>  bleSnapshotPool;
+
+WifiSnapshot* latestWifi   = nullptr;
+WifiSnapshot* previousWifi = nullptr;
+BleSnapshot*  latestBle    = nullptr;
+uint32_t      snapshotVersionCounter = 0;
+
+// Optional Wi-Fi scanning between page requests, so alerts are raised even
+// when nobody is watching. Every scan takes the radio off the soft-AP
+// channel for a few seconds, which stalls the dashboard for connected
+// viewers, so it is off by default and toggled from the Wi-Fi page.
+const bool          BACKGROUND_WIFI_SCAN_DEFAULT = false;
+const unsigned long BACKGROUND_WIFI_INTERVAL_MS  = 30000UL;
+bool                backgroundWifiScan       = BACKGROUND_WIFI_SCAN_DEFAULT;
+bool                backgroundWifiScanActive = false;
+unsigned long       lastWifiScanEndMs        = 0;
+
+// ---------- Wi-Fi change detection & rogue AP alerts ----------
+
+struct WifiChange {
+  uint8_t type;
+  uint8_t prevIdx;  // into the previous snapshot's aps[], or WIFI_NO_INDEX
+  uint8_t curIdx;   // into the current snapshot's aps[], or WIFI_NO_INDEX
+};
+
+// Result of merging two consecutive snapshots. Indices stay valid as long as
+// previousWifi/latestWifi are the snapshots named by the versions.
+struct WifiChangeSet {
+  uint32_t   fromVersion;
+  uint32_t   toVersion;
+  uint16_t   count;
+  uint16_t   added, removed, securityChanged, channelChanged;
+  WifiChange changes[MAX_WIFI_APS * 2];
+};
+
+WifiChangeSet lastWifiChanges;
+
+enum WifiAlertType : uint8_t {
+  WIFI_ALERT_DUPLICATE_SSID,      // same SSID seen with a different security mode
+  WIFI_ALERT_SECURITY_DOWNGRADE,  // same BSSID now advertises weaker security
+  WIFI_ALERT_VENDOR_MISMATCH,     // SSID appears on a BSSID with an unknown OUI
+  WIFI_ALERT_CHANNEL_CHANGE,
+};
+
+struct WifiAlert {
+  uint8_t       type;
+  uint8_t       bssid[6];
+  uint8_t       oldAuth;
+  uint8_t       newAuth;
+  uint8_t       oldChannel;
+  uint8_t       newChannel;
+  char          ssid[33];
+  unsigned long atMs;
+};
+
+const int      WIFI_ALERT_LOG       = 32;
+const uint16_t SSID_INDEX_SIZE      = 128;  // power of two
+const uint8_t  SSID_MAX_OUIS        = 4;
+
+// What we have learned about one SSID across all scans since boot
+struct SsidProfile {
+  uint32_t hash;      // 0 marks an empty slot
+  uint16_t authMask;  // bit per wifi_auth_mode_t seen
+  uint8_t  ouiCount;
+  uint8_t  ouis[SSID_MAX_OUIS][3];
+  char     ssid[33];
+};
+
+WifiAlert    wifiAlerts[WIFI_ALERT_LOG];
+uint32_t     wifiAlertCount = 0;   // ring position is wifiAlertCount % WIFI_ALERT_LOG
+SsidProfile* ssidIndex = nullptr;
+uint32_t     ssidIndexFull = 0;    // SSIDs not tracked because the index was full
+uint32_t     ssidOuiOverflows = 0; // new OUIs seen on an SSID whose OUI list was full
+
+bool beginSsidIndex() {
+  ssidIndex = (SsidProfile*)allocLargeTable(sizeof(SsidProfile) * SSID_INDEX_SIZE);
+  return ssidIndex != nullptr;
+}
+
+// Weaker modes rank lower; used to tell a downgrade from an upgrade
+int authStrength(uint8_t auth) {
+  switch (auth) {
+    case WIFI_AUTH_OPEN:            return 0;
+    case WIFI_AUTH_WEP:             return 1;
+    case WIFI_AUTH_WPA_PSK:         return 2;
+    case WIFI_AUTH_WPA_WPA2_PSK:    return 3;
+    case WIFI_AUTH_WPA2_PSK:        return 4;
+    case WIFI_AUTH_WPA2_WPA3_PSK:   return 5;
+    case WIFI_AUTH_WPA3_PSK:        return 6;
+    case WIFI_AUTH_WPA2_ENTERPRISE: return 6;
+    default:                        return 3;
+  }
+}
+
+const WifiAlert* recentWifiAlert(uint32_t age) {
+  if (age >= wifiAlertCount || age >= (uint32_t)WIFI_ALERT_LOG) return nullptr;
+  return &wifiAlerts[(wifiAlertCount - 1 - age) % WIFI_ALERT_LOG];
+}
+
+void raiseWifiAlert(uint8_t type, const WifiApRecord& ap, uint8_t oldAuth, uint8_t oldChannel) {
+  WifiAlert& a = wifiAlerts[wifiAlertCount % WIFI_ALERT_LOG];
+  a.type       = type;
+  a.oldAuth    = oldAuth;
+  a.newAuth    = ap.authMode;
+  a.oldChannel = oldChannel;
+  a.newChannel = ap.channel;
+  a.atMs       = millis();
+  memcpy(a.bssid, ap.bssid, sizeof(a.bssid));
+  memcpy(a.ssid, ap.ssid, sizeof(a.ssid));
+  wifiAlertCount++;
+}
+
+SsidProfile* lookupSsidProfile(const char* ssid) {
+  uint32_t h = hashBytes((const uint8_t*)ssid, strlen(ssid)) | 1;  // never 0
+  for (uint16_t probe = 0; probe < SSID_INDEX_SIZE; ++probe) {
+    SsidProfile& p = ssidIndex[(h + probe) & (SSID_INDEX_SIZE - 1)];
+    if (p.hash == 0) {
+      p.hash = h;
+      memcpy(p.ssid, ssid, sizeof(p.ssid));
+      return &p;
+    }
+    if (p.hash == h && strcmp(p.ssid, ssid) == 0) return &p;
+  }
+  ssidIndexFull++;
+  return nullptr;
+}
+
+// A BSSID appeared: check it against everything known about its SSID. Only
+// newly seen security modes or OUIs alert, so flapping APs don't spam.
+void learnWifiAp(const WifiApRecord& ap) {
+  if (!ssidIndex || ap.ssid[0] == '\0') return;  // hidden networks can't be matched
+  SsidProfile* p = lookupSsidProfile(ap.ssid);
+  if (!p) return;
+
+  bool known = p->authMask != 0;
+  uint16_t authBit = ap.authMode < 16 ? (1u << ap.authMode) : 0;
+  if (known && authBit && !(p->authMask & authBit)) {
+    uint8_t prevAuth = 0;
+    while (prevAuth < 16 && !(p->authMask & (1u << prevAuth))) prevAuth++;
+    raiseWifiAlert(WIFI_ALERT_DUPLICATE_SSID, ap, prevAuth, ap.channel);
+  }
+  p->authMask |= authBit;
+
+  // Locally administered BSSIDs (mesh nodes, phone hotspots, extra VAPs)
+  // carry no vendor OUI, so there is nothing to compare
+  if (ap.bssid[0] & 0x02) return;
+
+  bool ouiKnown = false;
+  for (uint8_t i = 0; i < p->ouiCount; ++i) {
+    if (memcmp(p->ouis[i], ap.bssid, 3) == 0) ouiKnown = true;
+  }
+  if (ouiKnown) return;
+  if (known) raiseWifiAlert(WIFI_ALERT_VENDOR_MISMATCH, ap, ap.authMode, ap.channel);
+  // A full list still alerts above; the OUI just can't be remembered
+  if (p->ouiCount < SSID_MAX_OUIS) memcpy(p->ouis[p->ouiCount++], ap.bssid, 3);
+  else ssidOuiOverflows++;
+}
+
+void addWifiChange(uint8_t type, uint8_t prevIdx, uint8_t curIdx) {
+  WifiChangeSet& cs = lastWifiChanges;
+  if (cs.count >= MAX_WIFI_APS * 2) return;
+  cs.changes[cs.count++] = WifiChange{ type, prevIdx, curIdx };
+}
+
+// Record the change set between two snapshots and feed additions and
+// changes to the SSID index.
+void diffWifiSnapshots(const WifiSnapshot* prev, const WifiSnapshot* cur) {
+  WifiChangeSet& cs = lastWifiChanges;
+  cs.fromVersion = prev ? prev->version : 0;
+  cs.toVersion   = cur->version;
+  cs.count = cs.added = cs.removed = cs.securityChanged = cs.channelChanged = 0;
+
+  diffByBssid(prev ? prev->aps : nullptr, prev ? prev->byBssid : nullptr, prev ? prev->count : 0,
+              cur->aps, cur->byBssid, cur->count,
+              [&](uint8_t type, uint8_t prevIdx, uint8_t curIdx) {
+    addWifiChange(type, prevIdx, curIdx);
+    switch (type) {
+      case WIFI_AP_REMOVED:
+        cs.removed++;
+        break;
+      case WIFI_AP_ADDED:
+        cs.added++;
+        learnWifiAp(cur->aps[curIdx]);
+        break;
+      case WIFI_AP_SECURITY_CHANGED: {
+        const WifiApRecord& was = prev->aps[prevIdx];
+        const WifiApRecord& now = cur->aps[curIdx];
+        cs.securityChanged++;
+        if (authStrength(now.authMode) < authStrength(was.authMode)) {
+          raiseWifiAlert(WIFI_ALERT_SECURITY_DOWNGRADE, now, was.authMode, was.channel);
+        }
+        learnWifiAp(now);
+        break;
+      }
+      case WIFI_AP_CHANNEL_CHANGED: {
+        const WifiApRecord& was = prev->aps[prevIdx];
+        cs.channelChanged++;
+        raiseWifiAlert(WIFI_ALERT_CHANNEL_CHANGE, cur->aps[curIdx], was.authMode, was.channel);
+        break;
+      }
+    }
+  });
+}
+
+const char* describeWifiAlert(uint8_t type) {
+  switch (type) {
+    case WIFI_ALERT_DUPLICATE_SSID:     return "SSID seen with different security (possible evil twin)";
+    case WIFI_ALERT_SECURITY_DOWNGRADE: return "Security downgraded on same BSSID";
+    case WIFI_ALERT_VENDOR_MISMATCH:    return "SSID on BSSID from a new vendor (OUI)";
+    case WIFI_ALERT_CHANNEL_CHANGE:     return "AP changed channel";
+    default:                            return "Unknown";
+  }
+}
+
+const char* wifiAlertClass(uint8_t type) {
+  switch (type) {
+    case WIFI_ALERT_DUPLICATE_SSID:
+    case WIFI_ALERT_SECURITY_DOWNGRADE: return "bad";
+    case WIFI_ALERT_VENDOR_MISMATCH:    return "warn";
+    default:                            return "ok";
+  }
+}
+
+// ---------- RF interference model & soft-AP channel selection ----------
+
+struct ChannelInterference {
+  uint32_t snapshotVersion;
+  uint8_t  apCount[RF_CHANNELS + 1];   // APs whose primary channel is this one (1-based)
+  float    powerMw[RF_CHANNELS + 1];   // received beacon power on the channel itself
+  float    scoreDbm[RF_CHANNELS + 1];  // power landing on the channel after overlap
+  uint8_t  bestChannel;                // quietest of AP_CHANNEL_CANDIDATES
+};
+
+ChannelInterference latestInterference;
+
+// Soft-AP channel. Auto mode is off by default because moving the AP drops
+// connected clients for a moment.
+const bool          AUTO_AP_CHANNEL_DEFAULT     = false;
+const float         AP_CHANNEL_SWITCH_MARGIN_DB = 6.0f;
+const unsigned long AP_CHANNEL_MIN_DWELL_MS     = 10UL * 60UL * 1000UL;
+
+// Channels the AP may move to: non-overlapping at 20 MHz and legal in every
+// regulatory domain, so the scan's view of 12/13 never drags the AP there
+const uint8_t AP_CHANNEL_CANDIDATES[] = { 1, 6, 11 };
+
+bool          autoApChannel        = AUTO_AP_CHANNEL_DEFAULT;
+uint8_t       apChannel            = 1;
+uint8_t       pendingApChannel     = 0;  // applied from loop(), after the response is sent
+unsigned long lastApChannelMoveMs  = 0;
+uint32_t      apChannelMoves       = 0;
+
+// RSSI-weighted power per channel, then the overlap kernel applied across
+// neighbours. Strong nearby APs dominate, as they do on air.
+void computeChannelInterference(const WifiSnapshot* snap, ChannelInterference& out) {
+  memset(&out, 0, sizeof(out));
+  out.snapshotVersion = snap->version;
+  for (uint16_t i = 0; i < snap->count; ++i) {
+    int ch = snap->aps[i].channel;
+    if (ch < 1 || ch > RF_CHANNELS) continue;
+    out.apCount[ch]++;
+    out.powerMw[ch] += powf(10.0f, snap->aps[i].rssi / 10.0f);
+  }
+
+  spreadChannelPower(out.powerMw, out.scoreDbm);
+  out.bestChannel = quietestChannel(out.scoreDbm, AP_CHANNEL_CANDIDATES, sizeof(AP_CHANNEL_CANDIDATES));
+}
+
+// Only move when the gain is clear and not too often, so two monitors in
+// the same venue don't chase each other around the band.
+void considerApChannelMove(const ChannelInterference& ci) {
+  if (!autoApChannel || ci.snapshotVersion == 0) return;
+  if (lastApChannelMoveMs && millis() - lastApChannelMoveMs < AP_CHANNEL_MIN_DWELL_MS) return;
+  if (ci.bestChannel == apChannel) return;
+  if (ci.scoreDbm[apChannel] - ci.scoreDbm[ci.bestChannel] < AP_CHANNEL_SWITCH_MARGIN_DB) return;
+  pendingApChannel = ci.bestChannel;
+}
+
+void applyPendingApChannel() {
+  if (!pendingApChannel) return;
+  uint8_t ch = pendingApChannel;
+  pendingApChannel = 0;
+  if (!WiFi.softAP(apSSID, apPASS, ch)) {
+    Serial.printf("Failed to move AP to channel %u\n", ch);
+    return;
+  }
+  Serial.printf("AP moved from channel %u to %u\n", apChannel, ch);
+  apChannel = ch;
+  lastApChannelMoveMs = millis();
+  apChannelMoves++;
+}
+
+// ---------- Scan capture ----------
+
+// Copy the driver's scan results into a pooled snapshot and diff it against
+// the previous one. Falls back to the latest snapshot if the scan failed or
+// the pool is exhausted.
+WifiSnapshot* captureWifiSnapshot(int n) {
+  lastWifiScanEndMs = millis();
+  if (n < 0) return latestWifi;  // failed scan: don't report every AP as gone
+
+  WifiSnapshot* snap = wifiSnapshotPool.acquire();
+  if (!snap) {
+    WiFi.scanDelete();
+    return latestWifi;
+  }
+
+  snap->version   = ++snapshotVersionCounter;
+  snap->takenMs   = lastWifiScanEndMs;
+  snap->totalSeen = n;
+  for (int i = 0; i < n; ++i) {
+    wifi_ap_record_t* r = (wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+    if (!r) continue;
+    uniqueBssids.add(hashBytes(r->bssid, sizeof(r->bssid)), uniqueClockMs());
+    if (snap->count >= MAX_WIFI_APS) continue;
+    WifiApRecord& ap = snap->aps[snap->count++];
+    memcpy(ap.bssid, r->bssid, sizeof(ap.bssid));
+    memcpy(ap.ssid, r->ssid, sizeof(ap.ssid) - 1);
+    ap.rssi     = r->rssi;
+    ap.channel  = r->primary;
+    ap.authMode = (uint8_t)r->authmode;
+  }
+  WiFi.scanDelete();  // free the driver's copy right away
+
+  sortByBssid(snap->aps, snap->byBssid, snap->count);
+  diffWifiSnapshots(latestWifi, snap);
+  computeChannelInterference(snap, latestInterference);
+  considerApChannelMove(latestInterference);
+
+  wifiSnapshotPool.release(previousWifi);
+  previousWifi = latestWifi;
+  latestWifi = snap;
+  return snap;
+}
+
+void serviceBackgroundWifiScan() {
+  if (backgroundWifiScanActive) {
+    int16_t n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING) return;
+    backgroundWifiScanActive = false;
+    captureWifiSnapshot(n);
+    return;
+  }
+  if (!backgroundWifiScan || millis() - lastWifiScanEndMs < BACKGROUND_WIFI_INTERVAL_MS) return;
+  backgroundWifiScanActive = (WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING);
+  // A scan that fails to start (radio busy, AP channel switch) waits out a
+  // full interval instead of being retried on every loop pass
+  if (!backgroundWifiScanActive) lastWifiScanEndMs = millis();
+}
+
+// Run a blocking Wi-Fi scan for a page. If a background scan is already in
+// flight, wait for it and use its results instead of starting another.
+WifiSnapshot* scanWifiSnapshot() {
+  if (backgroundWifiScanActive) {
+    int16_t n;
+    while ((n = WiFi.scanComplete()) == WIFI_SCAN_RUNNING) delay(10);
+    backgroundWifiScanActive = false;
+    return captureWifiSnapshot(n);
+  }
+  return captureWifiSnapshot(WiFi.scanNetworks());
+}
+
+// ---------- BLE ingest (scan callback -> ring -> processing task) ----------
+
+struct BleObservation {
+  BleDeviceRecord rec;
+  unsigned long   atMs;
+  uint32_t        fingerprint;  // see parseAdvertPayload
+};
+
+// Everything heard recently, keyed by address. Written only by the ingest
+// task; pages copy out of it under bleDataMutex.
+struct BleTableEntry {
+  uint8_t  addr[6];
+  uint16_t home, prev, next;   // MacTable links
+  unsigned long firstSeenMs;
+  unsigned long lastSeenMs;
+  uint32_t adverts;
+  BleDeviceRecord rec;         // latest RSSI, last name/mfg/TX seen
+};
+
+// Without PSRAM the ring and table come out of the heap the radios need;
+// half a second of a busy hall and 128 devices is still enough for a room.
+const uint32_t      BLE_RING_CAPACITY_PSRAM     = 256;  // ~1 s of a busy hall
+const uint32_t      BLE_RING_CAPACITY_INTERNAL  = 128;
+const uint16_t      BLE_TABLE_CAPACITY_PSRAM    = 192;
+const uint16_t      BLE_TABLE_CAPACITY_INTERNAL = 128;
+const uint32_t      BLE_INGEST_BATCH   = 32;     // sightings per lock hold
+const uint32_t      BLE_INGEST_IDLE_MS = 20;
+const BaseType_t    BLE_INGEST_CORE    = 1;      // Bluedroid runs on core 0
+const unsigned long BLE_TABLE_TTL_MS   = 5 * 60 * 1000UL;
+const unsigned long BLE_RECENT_MS      = 30000UL;  // "nearby now" for pages
+const unsigned long BLE_SNAPSHOT_REUSE_MS = 2000UL; // viewers within this share one copy
+
+SpscRing<BleObservation> bleRing;
+MacTable<BleTableEntry>  bleTable;
+SemaphoreHandle_t        bleDataMutex = nullptr;
+
+struct BleIngestStats {
+  uint32_t processed  = 0;
+  uint32_t batches    = 0;
+  uint32_t maxBatch   = 0;
+  uint32_t evictions  = 0;   // table full, oldest device dropped
+  uint32_t expired    = 0;   // not heard for BLE_TABLE_TTL_MS
+  uint32_t rate       = 0;   // adverts/s accepted into the ring, last second
+  uint32_t peakRate   = 0;
+  uint32_t offeredRate     = 0;   // adverts/s from the stack, drops included
+  uint32_t peakOfferedRate = 0;
+  uint32_t rateBase    = 0;
+  uint32_t droppedBase = 0;
+  unsigned long rateBaseMs = 0;
+};
+BleIngestStats bleIngest;
+
+// Guards bleTable, bleIngest and presence, which the ingest task writes
+// while page handlers on the loop task read them.
+struct BleDataLock {
+  BleDataLock()  { if (bleDataMutex) xSemaphoreTake(bleDataMutex, portMAX_DELAY); }
+  ~BleDataLock() { if (bleDataMutex) xSemaphoreGive(bleDataMutex); }
+};
+
+// Pull name, TX power and manufacturer data straight out of the raw
+// advertising payload (AD structures: length, type, data). Returns a
+// fingerprint of the parts that stay put when a device rotates its random
+// address: the AD layout, name, service UUIDs, appearance and company ID.
+uint32_t parseAdvertPayload(const uint8_t* p, size_t len, BleDeviceRecord& rec) {
+  uint8_t shape[64];
+  size_t  shapeLen = 0;
+  bool haveCompleteName = false;
+  size_t i = 0;
+  while (p && i + 1 < len) {
+    uint8_t fieldLen = p[i];
+    if (fieldLen == 0 || i + 1 + fieldLen > len) break;
+    uint8_t        type    = p[i + 1];
+    const uint8_t* data    = p + i + 2;
+    size_t         dataLen = fieldLen - 1;
+
+    size_t stable = 0;  // leading data bytes that identify the device
+    if (type == 0x08 || type == 0x09 || (type >= 0x02 && type <= 0x07) || type == 0x19) stable = dataLen;
+    else if (type == 0xFF) stable = dataLen < 2 ? dataLen : 2;
+    if (shapeLen + 2 + stable <= sizeof(shape)) {
+      shape[shapeLen++] = type;
+      shape[shapeLen++] = fieldLen;
+      memcpy(shape + shapeLen, data, stable);
+      shapeLen += stable;
+    }
+
+    if ((type == 0x08 && !haveCompleteName) || type == 0x09) {  // short / complete name
+      size_t n = dataLen < sizeof(rec.name) - 1 ? dataLen : sizeof(rec.name) - 1;
+      memcpy(rec.name, data, n);
+      rec.name[n] = '\0';
+      if (type == 0x09) haveCompleteName = true;
+    } else if (type == 0x0A && dataLen >= 1) {                  // TX power level
+      rec.txPower     = (int8_t)data[0];
+      rec.haveTxPower = true;
+    } else if (type == 0xFF) {                                  // manufacturer data
+      rec.mfgTotal = dataLen;
+      rec.mfgLen   = dataLen < sizeof(rec.mfg) ? dataLen : sizeof(rec.mfg);
+      memcpy(rec.mfg, data, rec.mfgLen);
+    }
+    i += 1 + fieldLen;
+  }
+  return hashBytes(shape, shapeLen);
+}
+
+// Runs on the BLE host task for every advert (duplicates included). It
+// only copies into the ring: no heap, no locks, and a full ring drops.
+class BleIngestCallbacks : public BLEAdvertisedDeviceCallbacks {
+  void onResult(BLEAdvertisedDevice dev) override {
+    BleObservation* obs = bleRing.reserve();
+    if (!obs) return;
+    memset(obs, 0, sizeof(*obs));
+    memcpy(obs->rec.addr, *dev.getAddress().getNative(), sizeof(obs->rec.addr));
+    obs->rec.rssi = (int8_t)dev.getRSSI();
+    obs->fingerprint = parseAdvertPayload(dev.getPayload(), dev.getPayloadLength(), obs->rec);
+    obs->atMs = millis();
+    bleRing.commit();
+  }
+};
+
+BleIngestCallbacks bleIngestCallbacks;
+
+// Fold one sighting into the unique counters, the device table and the
+// presence engine.
+// Name, TX power and manufacturer data only overwrite when present, since
+// scan responses and adverts carry different fields.
+void ingestObservation(const BleObservation& obs) {
+  uint64_t nowMs = uniqueClockMs();
+  uniqueBleAddrs.add(hashBytes(obs.rec.addr, sizeof(obs.rec.addr)), nowMs);
+  uniqueBlePayloads.add(obs.fingerprint, nowMs);
+
+  BleTableEntry* e = bleTable.find(obs.rec.addr);
+  if (e) {
+    bleTable.touch(e);
+  } else {
+    if (bleTable.full()) {
+      bleTable.remove(bleTable.oldest());
+      bleIngest.evictions++;
+    }
+    e = bleTable.insert(obs.rec.addr);
+    if (!e) return;
+    e->firstSeenMs = obs.atMs;
+    memcpy(e->rec.addr, obs.rec.addr, sizeof(e->rec.addr));
+  }
+  e->lastSeenMs = obs.atMs;
+  e->adverts++;
+  e->rec.rssi = obs.rec.rssi;
+  if (obs.rec.name[0]) memcpy(e->rec.name, obs.rec.name, sizeof(e->rec.name));
+  if (obs.rec.haveTxPower) {
+    e->rec.txPower     = obs.rec.txPower;
+    e->rec.haveTxPower = true;
+  }
+  if (obs.rec.mfgTotal) {
+    e->rec.mfgTotal = obs.rec.mfgTotal;
+    e->rec.mfgLen   = obs.rec.mfgLen;
+    memcpy(e->rec.mfg, obs.rec.mfg, obs.rec.mfgLen);
+  }
+
+  presence.observe(obs.rec.addr, obs.rec.rssi, obs.atMs, currentHourSlot());
+}
+
+// Take up to one batch off the ring under a single lock hold
+uint32_t drainBleRing() {
+  uint32_t n = bleRing.available();
+  if (n > BLE_INGEST_BATCH) n = BLE_INGEST_BATCH;
+  if (n == 0) return 0;
+  {
+    BleDataLock lock;
+    for (uint32_t i = 0; i < n; ++i) ingestObservation(bleRing.peek(i));
+    bleIngest.processed += n;
+    bleIngest.batches++;
+    if (n > bleIngest.maxBatch) bleIngest.maxBatch = n;
+  }
+  bleRing.consume(n);
+  return n;
+}
+
+// Once a second, under the lock: close presence sessions, age out the
+// table and sample the sustained advert rate.
+void bleIngestHousekeeping(unsigned long now) {
+  BleDataLock lock;
+  presence.tick(now, currentHourSlot());
+
+  BleTableEntry* e;
+  while ((e = bleTable.oldest()) != nullptr && now - e->lastSeenMs > BLE_TABLE_TTL_MS) {
+    bleTable.remove(e);
+    bleIngest.expired++;
+  }
+
+  // Accepted alone flattens out at the drain rate exactly when the ring
+  // overflows, so report what the stack offered alongside it
+  unsigned long elapsed = now - bleIngest.rateBaseMs;
+  uint32_t pushed  = bleRing.pushed.load(std::memory_order_relaxed);
+  uint32_t dropped = bleRing.dropped.load(std::memory_order_relaxed);
+  if (bleIngest.rateBaseMs != 0 && elapsed > 0) {
+    uint32_t accepted = pushed - bleIngest.rateBase;
+    uint32_t offered  = accepted + (dropped - bleIngest.droppedBase);
+    bleIngest.rate        = (uint32_t)((uint64_t)accepted * 1000 / elapsed);
+    bleIngest.offeredRate = (uint32_t)((uint64_t)offered * 1000 / elapsed);
+    if (bleIngest.rate > bleIngest.peakRate) bleIngest.peakRate = bleIngest.rate;
+    if (bleIngest.offeredRate > bleIngest.peakOfferedRate) bleIngest.peakOfferedRate = bleIngest.offeredRate;
+  }
+  bleIngest.rateBase    = pushed;
+  bleIngest.droppedBase = dropped;
+  bleIngest.rateBaseMs  = now;
+}
+
+void bleIngestTask(void*) {
+  unsigned long lastHousekeepingMs = 0;
+  for (;;) {
+    uint32_t n = drainBleRing();
+    unsigned long now = millis();
+    if (now - lastHousekeepingMs >= 1000) {
+      lastHousekeepingMs = now;
+      bleIngestHousekeeping(now);
+    }
+    // A full batch means there is probably more waiting
+    if (n < BLE_INGEST_BATCH) vTaskDelay(pdMS_TO_TICKS(BLE_INGEST_IDLE_MS));
+  }
+}
+
+bool startBleIngest() {
+  bleDataMutex = xSemaphoreCreateMutex();
+  bool psram = psramFound();
+  if (!bleDataMutex ||
+      !bleRing.begin(psram ? BLE_RING_CAPACITY_PSRAM : BLE_RING_CAPACITY_INTERNAL) ||
+      !bleTable.begin(psram ? BLE_TABLE_CAPACITY_PSRAM : BLE_TABLE_CAPACITY_INTERNAL)) {
+    return false;
+  }
+  return xTaskCreatePinnedToCore(bleIngestTask, "bleIngest", 4096, nullptr, 1, nullptr, BLE_INGEST_CORE) == pdPASS;
+}
+
+// Copy the devices heard in the last BLE_RECENT_MS, newest first, into a
+// pooled snapshot so pages render without holding the lock.
+BleSnapshot* refreshBleSnapshot() {
+  if (!bleTable.ready()) return latestBle;
+  if (latestBle && millis() - latestBle->takenMs < BLE_SNAPSHOT_REUSE_MS) return latestBle;
+  BleSnapshot* snap = bleSnapshotPool.acquire();
+  if (!snap) return latestBle;
+
+  unsigned long now;
+  {
+    BleDataLock lock;
+    now = millis();  // inside the lock so no entry is newer than now
+    for (BleTableEntry* e = bleTable.newest(); e && now - e->lastSeenMs <= BLE_RECENT_MS; e = bleTable.older(e)) {
+      if (snap->count < MAX_BLE_DEVICES) snap->devices[snap->count++] = e->rec;
+      snap->totalSeen++;
+    }
+  }
+  snap->version = ++snapshotVersionCounter;
+  snap->takenMs = now;
+
+  bleSnapshotPool.release(latestBle);
+  latestBle = snap;
+  return snap;
+}
+
+bool lookupBleDevice(const uint8_t addr[6], BleTableEntry& out) {
+  if (!bleTable.ready()) return false;
+  BleDataLock lock;
+  const BleTableEntry* e = bleTable.find(addr);
+  if (!e) return false;
+  out = *e;
+  return true;
+}
+
+// ---------- Admission control & load shedding ----------
+
+// Every route declares what it costs. Wi-Fi scans hold the radio for
+// seconds and grow the driver's result list on the heap, so those are the
+// ones limited. BLE pages read the continuously fed device table.
+//
+// There is deliberately no work queue. WebServer serves one connection at a
+// time from loop(), so while a scan runs nothing else is even accepted: a
+// queued request would have no one to hand it to and its client would just
+// wait longer in the lwIP backlog. Shedding happens at the front instead,
+// with a start-time budget and the shared snapshot as the fallback.
+enum RouteCost : uint8_t {
+  COST_LIGHT,      // renders from memory
+  COST_WIFI_SCAN,  // ~2-3 s Wi-Fi scan
+};
+
+enum Admission : uint8_t {
+  ADMIT_RUN,     // do the work
+  ADMIT_CACHED,  // render from the last snapshot instead
+  ADMIT_REJECT,  // 503 + Retry-After
+};
+
+// Largest free block each class needs before it may start
+const size_t ROUTE_HEAP_NEED[] = { 6 * 1024, 16 * 1024 };
+
+const unsigned long SCAN_REUSE_MS         = 5000UL;   // viewers within this share one scan
+const int           SCAN_BUDGET_SLOTS     = 3;        // expensive scans allowed per window
+const unsigned long SCAN_BUDGET_WINDOW_MS = 20000UL;
+const unsigned long NO_SNAPSHOT           = 0xFFFFFFFFUL;
+
+unsigned long scanBudget[SCAN_BUDGET_SLOTS];  // start times, oldest at scanBudgetNext
+int           scanBudgetNext = 0;
+unsigned long retryAfterSeconds = 1;          // set when a request is rejected
+
+uint32_t admitRan          = 0;
+uint32_t admitReused       = 0;
+uint32_t admitCachedBusy   = 0;
+uint32_t admitCachedHeap   = 0;
+uint32_t admitRejectedBusy = 0;
+uint32_t admitRejectedHeap = 0;
+
+unsigned long snapshotAgeMs(unsigned long takenMs) {
+  return millis() - takenMs;
+}
+
+// Decide how to serve a request of the given cost. snapshotAge is how old
+// the data we could fall back to is, or NO_SNAPSHOT if there is none.
+Admission admitRequest(RouteCost cost, unsigned long snapshotAge) {
+  size_t maxAlloc = ESP.getMaxAllocHeap();
+  bool haveCached = snapshotAge != NO_SNAPSHOT;
+
+  if (cost == COST_LIGHT) {
+    if (maxAlloc >= ROUTE_HEAP_NEED[COST_LIGHT]) return ADMIT_RUN;
+    admitRejectedHeap++;
+    retryAfterSeconds = 5;
+    return ADMIT_REJECT;
+  }
+
+  if (haveCached && snapshotAge < SCAN_REUSE_MS) {
+    admitReused++;
+    return ADMIT_CACHED;
+  }
+
+  if (maxAlloc < ROUTE_HEAP_NEED[cost]) {
+    if (haveCached) {
+      admitCachedHeap++;
+      return ADMIT_CACHED;
+    }
+    admitRejectedHeap++;
+    retryAfterSeconds = 5;
+    return ADMIT_REJECT;
+  }
+
+  unsigned long now = millis();
+  unsigned long oldest = scanBudget[scanBudgetNext];
+  if (oldest != 0 && now - oldest < SCAN_BUDGET_WINDOW_MS) {
+    if (haveCached) {
+      admitCachedBusy++;
+      return ADMIT_CACHED;
+    }
+    admitRejectedBusy++;
+    retryAfterSeconds = (SCAN_BUDGET_WINDOW_MS - (now - oldest)) / 1000 + 1;
+    return ADMIT_REJECT;
+  }
+
+  scanBudget[scanBudgetNext] = now ? now : 1;
+  scanBudgetNext = (scanBudgetNext + 1) % SCAN_BUDGET_SLOTS;
+  admitRan++;
+  return ADMIT_RUN;
+}
+
+unsigned long wifiSnapshotAge() {
+  return latestWifi ? snapshotAgeMs(latestWifi->takenMs) : NO_SNAPSHOT;
+}
+
+const char* resetReasonToString(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_POWERON:   return "Power-on";
+    case ESP_RST_EXT:       return "External reset pin";
+    case ESP_RST_SW:        return "Software restart";
+    case ESP_RST_PANIC:     return "Exception / panic";
+    case ESP_RST_INT_WDT:   return "Interrupt watchdog";
+    case ESP_RST_TASK_WDT:  return "Task watchdog";
+    case ESP_RST_WDT:       return "Other watchdog";
+    case ESP_RST_DEEPSLEEP: return "Deep-sleep wake";
+    case ESP_RST_BROWNOUT:  return "Brownout";
+    case ESP_RST_SDIO:      return "SDIO";
+    default:                return "Unknown";
+  }
+}
+
+// Resets that suggest the unit fell over rather than was restarted on purpose
+bool isAbnormalReset(esp_reset_reason_t reason) {
+  return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+         reason == ESP_RST_WDT || reason == ESP_RST_BROWNOUT;
+}
+
+// ---------- Rendered page cache ----------
+
+// Scan-backed pages are memoized against the versions of the data they
+// were rendered from, so viewers between two data changes share one
+// render. Cached pages print times as uptime stamps rather than "N s ago";
+// entries still expire after PAGE_CACHE_MAX_AGE_MS for the live counters.
+enum CachedPage : uint8_t {
+  PAGE_WIFI,
+  PAGE_BLE,
+  PAGE_CROWD,
+  PAGE_RF,
+  CACHED_PAGE_COUNT,
+};
+
+// Only the body after the shared head is cached. The head (~5.6 KB of CSS
+// and nav) never changes for a page, so it is re-rendered from flash on
+// every hit instead of taking up cache RAM.
+const char* const CACHED_PAGE_TITLE[CACHED_PAGE_COUNT] = {
+  "ESP32 Wi-Fi Scan", "ESP32 Bluetooth Devices", "ESP32 Crowd Density", "ESP32 RF Interference",
+};
+const char* const CACHED_PAGE_NAV[CACHED_PAGE_COUNT] = { "wifi", "ble", "crowd", "rf" };
+
+// Each page owns a fixed slice of one block carved at boot, so caching
+// never reallocates on the heap the radio stacks share. A body larger than
+// its slice is served uncached and counted in oversize. Largest bodies
+// rendered: /wifi 12.9 KB (48 APs with 32-char SSIDs, 16 changes, 10
+// alerts), /ble 11.2 KB (64 named devices), /crowd 5.7 KB, /rf 3.5 KB.
+// Without PSRAM the BLE page, which is cheap to render and changes every
+// few seconds, gets no slice.
+const size_t PAGE_CACHE_SLICE_INTERNAL[CACHED_PAGE_COUNT] = { 14 * 1024, 0, 7 * 1024, 4 * 1024 };
+const size_t PAGE_CACHE_SLICE_PSRAM[CACHED_PAGE_COUNT]    = { 32 * 1024, 24 * 1024, 16 * 1024, 16 * 1024 };
+const unsigned long PAGE_CACHE_MAX_AGE_MS = 10000UL;
+
+struct PageCacheEntry {
+  char*    body        = nullptr;   // this page's slice of PageCache::block
+  size_t   length      = 0;
+  size_t   capacity    = 0;
+  uint32_t dataVersion = 0;
+  uint32_t generation  = 0;   // 0 = empty; otherwise unique per render, used in the ETag
+  unsigned long renderedMs = 0;
+  unsigned long lastUsedMs = 0;
+};
+
+struct PageCache {
+  PageCacheEntry entries[CACHED_PAGE_COUNT];
+  char*    block      = nullptr;
+  size_t   budget     = 0;
+  uint32_t bootSalt   = 0;    // keeps ETags from a previous boot from matching
+  uint32_t generation = 0;
+  bool     inPsram    = false;
+
+  uint32_t hits        = 0;
+  uint32_t notModified = 0;
+  uint32_t misses      = 0;
+  uint32_t oversize    = 0;   // render larger than its page's slice
+
+  bool begin() {
+    bootSalt = esp_random();
+    const size_t* slices = psramFound() ? PAGE_CACHE_SLICE_PSRAM : PAGE_CACHE_SLICE_INTERNAL;
+    size_t total = 0;
+    for (uint8_t i = 0; i < CACHED_PAGE_COUNT; ++i) total += slices[i];
+    block = (char*)allocLargeTable(total, &inPsram);
+    if (!block) return false;
+    budget = total;
+    char* at = block;
+    for (uint8_t i = 0; i < CACHED_PAGE_COUNT; ++i) {
+      entries[i].body     = slices[i] ? at : nullptr;
+      entries[i].capacity = slices[i];
+      at += slices[i];
+    }
+    return true;
+  }
+
+  // Bytes of cached bodies currently held
+  size_t bytesHeld() const {
+    size_t n = 0;
+    for (uint8_t i = 0; i < CACHED_PAGE_COUNT; ++i) {
+      if (entries[i].generation) n += entries[i].length;
+    }
+    return n;
+  }
+
+  // The entry for page if it was rendered from dataVersion recently enough
+  const PageCacheEntry* lookup(CachedPage page, uint32_t dataVersion) {
+    PageCacheEntry& e = entries[page];
+    unsigned long now = millis();
+    if (e.generation == 0 || e.dataVersion != dataVersion || now - e.renderedMs >= PAGE_CACHE_MAX_AGE_MS) {
+      misses++;
+      return nullptr;
+    }
+    e.lastUsedMs = now;
+    hits++;
+    return &e;
+  }
+
+  // Copy a fresh render in. Returns nullptr if it does not fit the page's
+  // slice, in which case the page's old entry is gone too.
+  const PageCacheEntry* store(CachedPage page, uint32_t dataVersion, const char* data, size_t len) {
+    PageCacheEntry& e = entries[page];
+    e.generation = 0;
+    if (len > e.capacity) {
+      if (e.capacity) oversize++;
+      return nullptr;
+    }
+    memcpy(e.body, data, len);
+    e.length      = len;
+    e.dataVersion = dataVersion;
+    e.generation  = ++generation;
+    e.renderedMs  = e.lastUsedMs = millis();
+    return &e;
+  }
+
+  void formatEtag(const PageCacheEntry& e, char* buf, size_t len) const {
+    snprintf(buf, len, "\"%08lx-%lx\"", (unsigned long)bootSalt, (unsigned long)e.generation);
+  }
+};
+
+PageCache pageCache;
+
+// Fold the versions a page depends on into one key. Pages rendered after a
+// fresh scan omit the "showing an earlier scan" notice, so rescan is part
+// of it.
+uint32_t pageDataVersion(CachedPage page, bool rescan = false) {
+  uint32_t v[6] = { page, 0, 0, 0, 0, rescan };
+  switch (page) {
+    case PAGE_WIFI:
+      v[1] = latestWifi ? latestWifi->version : 0;
+      v[2] = wifiAlertCount;
+      v[3] = backgroundWifiScan;
+      break;
+    case PAGE_BLE:
+      v[1] = latestBle ? latestBle->version : 0;
+      break;
+    case PAGE_CROWD:
+      v[1] = latestWifi ? latestWifi->version : 0;
+      v[2] = latestBle ? latestBle->version : 0;
+      v[3] = presence.version;
+      break;
+    case PAGE_RF:
+      v[1] = latestWifi ? latestWifi->version : 0;
+      v[2] = apChannel | (pendingApChannel << 8) | ((uint32_t)autoApChannel << 16);
+      v[3] = apChannelMoves;
+      break;
+    default:
+      break;
+  }
+  return hashBytes((const uint8_t*)v, sizeof(v));
+}
+
 // ---------- Common HTML head + header/nav ----------
 
-String commonHtmlHead(const String& pageTitle, const String& active) {
-  String html;
-  html += F(
+void appendHtmlHead(PageBuffer& html, const char* pageTitle, const char* active) {
+  html.render(TPL(
     "<!DOCTYPE html>"
     "<html>"
     "<head>"
     "<meta charset='UTF-8'>"
     "<meta name='viewport' content='width=device-width, initial-scale=1'>"
-    "<title>"
-  );
-  html += pageTitle;
-  html += F(
-    "</title>"
+    "<title>{}</title>"
     "<style>"
     "body{font-family:Arial,Helvetica,sans-serif;background:#050509;color:#f3f3f3;margin:0;padding:0;}"
     ".topbar{position:sticky;top:0;z-index:10;background:rgba(5,5,12,0.96);backdrop-filter:blur(10px);"
@@ -159,18 +1426,11 @@ String commonHtmlHead(const String& pageTitle, const String& active) {
         "<span class='chip-pill'>AP 192.168.4.1</span>"
       "</div>"
       "<nav class='nav-links'>"
-  );
+  ), pageTitle);
 
   auto navLink = [&](const char* id, const char* href, const char* iconClass, const char* label) {
-    html += "<a class='nav-link";
-    if (active == id) html += " active";
-    html += "' href='";
-    html += href;
-    html += "'><span class='icon ";
-    html += iconClass;
-    html += "'></span><span>";
-    html += label;
-    html += "</span></a>";
+    html.render(TPL("<a class='nav-link{}' href='{}'><span class='icon {}'></span><span>{}</span></a>"),
+                strcmp(active, id) == 0 ? " active" : "", href, iconClass, label);
   };
 
   navLink("device", "/device", "icon-device", "Device");
@@ -180,23 +1440,39 @@ String commonHtmlHead(const String& pageTitle, const String& active) {
   navLink("crowd", "/crowd", "icon-crowd", "Crowd");
   navLink("rf", "/rf", "icon-rf", "Interference");
 
-  html += F(
+  html.render(TPL(
       "</nav>"
     "</div>"
     "<div class='container'>"
-  );
-  return html;
+  ));
+}
+
+void appendCachedPageHead(PageBuffer& html, CachedPage page) {
+  appendHtmlHead(html, CACHED_PAGE_TITLE[page], CACHED_PAGE_NAV[page]);
+}
+
+// Cached pages are served for a while after rendering, so times on them are
+// uptime stamps that stay true rather than ages that go stale
+void appendCachedNotice(PageBuffer& html, unsigned long takenMs) {
+  html.render(TPL("<div class='subtle'>Showing the scan taken at uptime {}; it was just taken or the unit is busy.</div>"),
+              uptimeAt(takenMs));
 }
 
 // ---------- Device page (/device) ----------
 
-String buildDevicePage() {
+void appendPoolRow(PageBuffer& html, const char* label, uint16_t inUse, uint16_t peak, uint16_t capacity,
+                   uint32_t failures, bool inPsram) {
+  html.render(TPL("<tr><td class='label'>{}</td><td>{} / {} in use (peak {}, {} exhausted) • {}</td></tr>"),
+              label, inUse, capacity, peak, failures, inPsram ? "PSRAM" : "internal");
+}
+
+void buildDevicePage(PageBuffer& html) {
   size_t heapSize   = ESP.getHeapSize();
   size_t freeHeap   = ESP.getFreeHeap();
   float  heapRatio  = heapSize ? (float)freeHeap / (float)heapSize : 0.0f;
 
-  String heapClass = "ok";
-  String heapText  = "Healthy";
+  const char* heapClass = "ok";
+  const char* heapText  = "Healthy";
   if (heapRatio < 0.3f) {
     heapClass = "bad"; heapText = "Low";
   } else if (heapRatio < 0.6f) {
@@ -204,52 +1480,132 @@ String buildDevicePage() {
   }
 
   bool serialActive = isSerialActiveRecently();
+  esp_reset_reason_t resetReason = esp_reset_reason();
+
+  char uptime[32];
+  formatUptime(uptime, sizeof(uptime));
+
+  appendHtmlHead(html, "ESP32 Device", "device");
+  html.render(TPL("<h1>Device</h1>"));
+
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot ok'></span><span>Wi-Fi Access Point</span></div>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span><span>Heap: {}</span></div>"),
+              heapClass, heapText);
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span>"), serialActive ? "ok" : "warn");
+  html.render(TPL("<span>Host: {}</span></div>"),
+              serialActive ? "Serial activity detected" : "No recent serial activity");
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span><span>Last reset: {}"
+                  "</span></div>"),
+              isAbnormalReset(resetReason) ? "bad" : "ok", resetReasonToString(resetReason));
+  html.render(TPL("</div>"));
+
+  html.render(TPL("<h2>Chip</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Model</td><td>{}</td></tr>"), ESP.getChipModel());
+  html.render(TPL("<tr><td class='label'>Revision</td><td>{}</td></tr>"), ESP.getChipRevision());
+  html.render(TPL("<tr><td class='label'>CPU Cores</td><td>{}</td></tr>"), ESP.getChipCores());
+  html.render(TPL("<tr><td class='label'>CPU Frequency</td><td>{} MHz</td></tr>"), ESP.getCpuFreqMHz());
+  html.render(TPL("<tr><td class='label'>SDK Version</td><td>{}</td></tr>"), ESP.getSdkVersion());
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>Flash</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Flash Size</td><td>{}</td></tr>"), asBytes(ESP.getFlashChipSize()));
+  html.render(TPL("<tr><td class='label'>Flash Speed</td><td>{} MHz</td></tr>"), ESP.getFlashChipSpeed() / 1000000);
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>Memory</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Heap Size</td><td>{}</td></tr>"), asBytes(heapSize));
+  html.render(TPL("<tr><td class='label'>Free Heap</td><td>{}</td></tr>"), asBytes(freeHeap));
+  html.render(TPL("<tr><td class='label'>Min Free Heap</td><td>{}</td></tr>"), asBytes(ESP.getMinFreeHeap()));
+  html.render(TPL("<tr><td class='label'>Max Alloc Heap</td><td>{}</td></tr>"), asBytes(ESP.getMaxAllocHeap()));
+  html.render(TPL("<tr><td class='label'>Max Alloc Heap (lowest)</td><td>{}</td></tr>"), asBytes(maxAllocHeapLow));
+  html.render(TPL("<tr><td class='label'>PSRAM Size</td><td>{}</td></tr>"), asBytes(ESP.getPsramSize()));
+  html.render(TPL("<tr><td class='label'>Free PSRAM</td><td>{}</td></tr>"), asBytes(ESP.getFreePsram()));
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>Allocators</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Request Arena</td><td>{} • {}</td></tr>"),
+              asBytes(requestArena.capacity), requestArena.inPsram ? "PSRAM" : "internal");
+  html.render(TPL("<tr><td class='label'>Arena High Water</td><td>{}</td></tr>"), asBytes(requestArena.highWater));
+  html.render(TPL("<tr><td class='label'>Arena Allocations</td><td>{} total, {} last request</td></tr>"),
+              requestArena.allocations, requestArena.lastRequestAllocs);
+  html.render(TPL("<tr><td class='label'>Arena Heap Spills</td><td>{}</td></tr>"), requestArena.spills);
+  appendPoolRow(html, "Wi-Fi Snapshot Pool", wifiSnapshotPool.inUse(), wifiSnapshotPool.peakInUse,
+                wifiSnapshotPool.capacity, wifiSnapshotPool.failures, wifiSnapshotPool.inPsram);
+  appendPoolRow(html, "BLE Snapshot Pool", bleSnapshotPool.inUse(), bleSnapshotPool.peakInUse,
+                bleSnapshotPool.capacity, bleSnapshotPool.failures, bleSnapshotPool.inPsram);
+  appendPoolRow(html, "BLE Device Table", bleTable.pool.inUse(), bleTable.pool.peakInUse,
+                bleTable.pool.capacity, bleTable.pool.failures, bleTable.pool.inPsram);
+  html.render(TPL("<tr><td class='label'>Page Cache</td><td>{} / {} • {} hits ({} not modified), {} renders, {}"
+                  " too large</td></tr>"),
+              asBytes(pageCache.bytesHeld()), asBytes(pageCache.budget), pageCache.hits, pageCache.notModified,
+              pageCache.misses, pageCache.oversize);
+  html.render(TPL("<tr><td class='label'>Tables in PSRAM</td><td>{}</td></tr>"), asBytes(largeTableBytesPsram));
+  html.render(TPL("<tr><td class='label'>Tables in Internal RAM</td><td>{}</td></tr>"),
+              asBytes(largeTableBytesInternal));
+  html.render(TPL("<tr><td class='label'>Tables Refused (heap reserve)</td><td>{}</td></tr>"), largeTablesRefused);
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>System</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Uptime</td><td>{}</td></tr>"), uptime);
+  html.render(TPL("<tr><td class='label'>Millis</td><td>{} ms</td></tr>"), millis());
+  html.render(TPL("<tr><td class='label'>Reset Reason</td><td>{} ({})</td></tr>"),
+              resetReasonToString(resetReason), (int)resetReason);
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>Load Shedding</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Scans run</td><td>{}</td></tr>"), admitRan);
+  html.render(TPL("<tr><td class='label'>Served from recent scan</td><td>{}</td></tr>"), admitReused);
+  html.render(TPL("<tr><td class='label'>Served cached (busy / low heap)</td><td>{} / {}</td></tr>"),
+              admitCachedBusy, admitCachedHeap);
+  html.render(TPL("<tr><td class='label'>Rejected 503 (busy / low heap)</td><td>{} / {}</td></tr>"),
+              admitRejectedBusy, admitRejectedHeap);
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<div class='footer'>ESP32 Monitor • Device view</div></div></body></html>"));
+}
 
-  String html = commonHtmlHead("ESP32 Device", "device");
-  html += "<h1>Device</h1>";
-
-  html += "<div class='card'>";
-  html += "<div class='status-pill'><span class='status-dot ok'></span><span>Wi-Fi Access Point</span></div>";
-  html += "<div class='status-pill'><span class='status-dot " + heapClass + "'></span><span>Heap: " + heapText + "</span></div>";
-  html += "<div class='status-pill'><span class='status-dot " + String(serialActive ? "ok" : "warn") + "'></span>";
-  html += "<span>Host: " + String(serialActive ? "Serial activity detected" : "No recent serial activity") + "</span></div>";
-  html += "</div>";
-
-  html += "<h2>Chip</h2><table>";
-  html += "<tr><td class='label'>Model</td><td>" + String(ESP.getChipModel()) + "</td></tr>";
-  html += "<tr><td class='label'>Revision</td><td>" + String(ESP.getChipRevision()) + "</td></tr>";
-  html += "<tr><td class='label'>CPU Cores</td><td>" + String(ESP.getChipCores()) + "</td></tr>";
-  html += "<tr><td class='label'>CPU Frequency</td><td>" + String(ESP.getCpuFreqMHz()) + " MHz</td></tr>";
-  html += "<tr><td class='label'>SDK Version</td><td>" + String(ESP.getSdkVersion()) + "</td></tr>";
-  html += "</table>";
-
-  html += "<h2>Flash</h2><table>";
-  html += "<tr><td class='label'>Flash Size</td><td>" + formatBytes(ESP.getFlashChipSize()) + "</td></tr>";
-  html += "<tr><td class='label'>Flash Speed</td><td>" + String(ESP.getFlashChipSpeed() / 1000000) + " MHz</td></tr>";
-  html += "</table>";
-
-  html += "<h2>Memory</h2><table>";
-  html += "<tr><td class='label'>Heap Size</td><td>" + formatBytes(heapSize) + "</td></tr>";
-  html += "<tr><td class='label'>Free Heap</td><td>" + formatBytes(freeHeap) + "</td></tr>";
-  html += "<tr><td class='label'>Min Free Heap</td><td>" + formatBytes(ESP.getMinFreeHeap()) + "</td></tr>";
-  html += "<tr><td class='label'>Max Alloc Heap</td><td>" + formatBytes(ESP.getMaxAllocHeap()) + "</td></tr>";
-  html += "<tr><td class='label'>PSRAM Size</td><td>" + formatBytes(ESP.getPsramSize()) + "</td></tr>";
-  html += "<tr><td class='label'>Free PSRAM</td><td>" + formatBytes(ESP.getFreePsram()) + "</td></tr>";
-  html += "</table>";
-
-  html += "<h2>System</h2><table>";
-  html += "<tr><td class='label'>Uptime</td><td>" + getUptimeString() + "</td></tr>";
-  html += "<tr><td class='label'>Millis</td><td>" + String(millis()) + " ms</td></tr>";
-  html += "<tr><td class='label'>Reset Reason CPU0</td><td>" + String(esp_reset_reason()) + "</td></tr>";
-  html += "</table>";
-
-  html += "<div class='footer'>ESP32 Monitor • Device view</div></div></body></html>";
-  return html;
+// Allocator counters as JSON, for soak/regression scripts that poll the unit
+void buildMemoryJson(PageBuffer& json) {
+  json.append("{\"heap\":{\"free\":", ESP.getFreeHeap(),
+              ",\"min_free\":", ESP.getMinFreeHeap(),
+              ",\"max_alloc\":", ESP.getMaxAllocHeap(),
+              ",\"max_alloc_low\":", maxAllocHeapLow, "}");
+  json.append(",\"arena\":{\"capacity\":", requestArena.capacity,
+              ",\"psram\":", requestArena.inPsram ? "true" : "false",
+              ",\"high_water\":", requestArena.highWater,
+              ",\"allocations\":", requestArena.allocations,
+              ",\"last_request_allocations\":", requestArena.lastRequestAllocs,
+              ",\"resets\":", requestArena.resets,
+              ",\"spills\":", requestArena.spills, "}");
+  json.append(",\"pools\":{\"wifi_snapshot\":{\"capacity\":", wifiSnapshotPool.capacity,
+              ",\"in_use\":", wifiSnapshotPool.inUse(),
+              ",\"peak\":", wifiSnapshotPool.peakInUse,
+              ",\"acquires\":", wifiSnapshotPool.acquires,
+              ",\"failures\":", wifiSnapshotPool.failures, "}");
+  json.append(",\"ble_snapshot\":{\"capacity\":", bleSnapshotPool.capacity,
+              ",\"in_use\":", bleSnapshotPool.inUse(),
+              ",\"peak\":", bleSnapshotPool.peakInUse,
+              ",\"acquires\":", bleSnapshotPool.acquires,
+              ",\"failures\":", bleSnapshotPool.failures, "}}");
+  json.append(",\"page_cache\":{\"budget\":", pageCache.budget, ",\"bytes\":", pageCache.bytesHeld(),
+              ",\"in_psram\":", pageCache.inPsram ? "true" : "false",
+              ",\"hits\":", pageCache.hits, ",\"not_modified\":", pageCache.notModified,
+              ",\"misses\":", pageCache.misses, ",\"oversize\":", pageCache.oversize, "}");
+  json.append(",\"tables\":{\"psram\":", largeTableBytesPsram, ",\"internal\":", largeTableBytesInternal,
+              ",\"refused\":", largeTablesRefused, "}");
+  json.append(",\"admission\":{\"ran\":", admitRan,
+              ",\"reused\":", admitReused,
+              ",\"cached_busy\":", admitCachedBusy,
+              ",\"cached_heap\":", admitCachedHeap,
+              ",\"rejected_busy\":", admitRejectedBusy,
+              ",\"rejected_heap\":", admitRejectedHeap,
+              ",\"reset_reason\":\"", resetReasonToString(esp_reset_reason()), "\"}}");
 }
 
 // ---------- Environment page (/environment) ----------
 
-String buildEnvironmentPage() {
+void buildEnvironmentPage(PageBuffer& html) {
   int   hall      = hallRead();
   float tempC     = readChipTemperatureC();
   float tempF     = tempC * 9.0f / 5.0f + 32.0f;
@@ -262,28 +1618,28 @@ String buildEnvironmentPage() {
 
   size_t freeHeap = ESP.getFreeHeap();
 
-  String html = commonHtmlHead("ESP32 Environment", "environment");
-  html += "<h1>Environment</h1>";
+  appendHtmlHead(html, "ESP32 Environment", "environment");
+  html.render(TPL("<h1>Environment</h1>"));
 
-  html += "<div class='card'>";
-  html += "<div><span class='badge'>On-chip and RF environment</span></div>";
-  html += "<div class='subtle'>Internal temperature and hall sensor measure the ESP32 die, not room air.</div>";
-  html += "</div>";
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<div><span class='badge'>On-chip and RF environment</span></div>"));
+  html.render(TPL("<div class='subtle'>Internal temperature and hall sensor measure the ESP32 die, not room air.</div>"));
+  html.render(TPL("</div>"));
 
-  html += "<h2>Temperature</h2><table>";
-  html += "<tr><td class='label'>Current</td><td>" + String(tempC, 1) + " °C / " + String(tempF, 1) + " °F</td></tr>";
+  html.render(TPL("<h2>Temperature</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Current</td><td>{} °C / {} °F</td></tr>"), fixed(tempC, 1), fixed(tempF, 1));
 
   if (tempStatsInitialized) {
-    html += "<tr><td class='label'>Min since boot</td><td>" + String(tempMinC, 1) + " °C</td></tr>";
-    html += "<tr><td class='label'>Max since boot</td><td>" + String(tempMaxC, 1) + " °C</td></tr>";
+    html.render(TPL("<tr><td class='label'>Min since boot</td><td>{} °C</td></tr>"), fixed(tempMinC, 1));
+    html.render(TPL("<tr><td class='label'>Max since boot</td><td>{} °C</td></tr>"), fixed(tempMaxC, 1));
   } else {
-    html += "<tr><td class='label'>Min/Max</td><td>Collecting data...</td></tr>";
+    html.render(TPL("<tr><td class='label'>Min/Max</td><td>Collecting data...</td></tr>"));
   }
 
-  html += "<tr><td class='label'>Free Heap</td><td>" + formatBytes(freeHeap) + "</td></tr>";
-  html += "</table>";
+  html.render(TPL("<tr><td class='label'>Free Heap</td><td>{}</td></tr>"), asBytes(freeHeap));
+  html.render(TPL("</table>"));
 
-  html += "<div class='temp-graph'>";
+  html.render(TPL("<div class='temp-graph'>"));
   if (tempHistoryCount > 0) {
     for (int i = 0; i < tempHistoryCount; ++i) {
       float t = tempHistory[i];
@@ -291,30 +1647,27 @@ String buildEnvironmentPage() {
       if (t > 80.0f) t = 80.0f;
       int height = (int)((t / 80.0f) * 100.0f + 0.5f);
 
-      html += "<div class='temp-bar' style=\"height:";
-      html += String(height);
-      html += "%;\"></div>";
+      html.render(TPL("<div class='temp-bar' style=\"height:{}%;\"></div>"), height);
     }
   }
-  html += "</div>";
-  html += "<div class='temp-baseline'><span>0 °C</span><span>80 °C</span></div>";
+  html.render(TPL("</div>"));
+  html.render(TPL("<div class='temp-baseline'><span>0 °C</span><span>80 °C</span></div>"));
 
-  html += "<h2>On-chip Sensor & Access Point</h2><table>";
-  html += "<tr><td class='label'>Hall Sensor (raw)</td><td>" + String(hall) + "</td></tr>";
-  html += "<tr><td class='label'>AP IP</td><td>" + apIP.toString() + "</td></tr>";
-  html += "<tr><td class='label'>AP Channel</td><td>" + String(channel == 0 ? 1 : channel) + "</td></tr>";
-  html += "<tr><td class='label'>Connected Stations</td><td>" + String(stations) + "</td></tr>";
-  html += "</table>";
+  html.render(TPL("<h2>On-chip Sensor & Access Point</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Hall Sensor (raw)</td><td>{}</td></tr>"), hall);
+  html.render(TPL("<tr><td class='label'>AP IP</td><td>{}</td></tr>"), apIP.toString());
+  html.render(TPL("<tr><td class='label'>AP Channel</td><td>{}</td></tr>"), channel == 0 ? 1 : (int)channel);
+  html.render(TPL("<tr><td class='label'>Connected Stations</td><td>{}</td></tr>"), stations);
+  html.render(TPL("</table>"));
 
-  html += "<div class='subtle'>Reload this page to update the temperature graph and stats.</div>";
+  html.render(TPL("<div class='subtle'>Reload this page to update the temperature graph and stats.</div>"));
 
-  html += "<div class='footer'>ESP32 Monitor • Environment view</div></div></body></html>";
-  return html;
+  html.render(TPL("<div class='footer'>ESP32 Monitor • Environment view</div></div></body></html>"));
 }
 
 // ---------- Wi-Fi scan page (/wifi) & AP detail ----------
 
-String encTypeToString(int t) {
+const char* encTypeToString(int t) {
   switch (t) {
     case WIFI_AUTH_OPEN:          return "OPEN";
     case WIFI_AUTH_WEP:           return "WEP";
@@ -328,83 +1681,189 @@ String encTypeToString(int t) {
   }
 }
 
-String guessRouterVendor(const String& ssid, const String& bssidPrefix) {
-  String s = ssid;
-  s.toLowerCase();
+// Returns nullptr when nothing matches; callers fall back to the OUI prefix
+const char* guessRouterVendor(const char* ssid) {
+  if (containsNoCase(ssid, "tp-link") || containsNoCase(ssid, "tplink")) return "TP-Link (SSID guess)";
+  if (containsNoCase(ssid, "netgear"))   return "Netgear (SSID guess)";
+  if (containsNoCase(ssid, "linksys"))   return "Linksys (SSID guess)";
+  if (containsNoCase(ssid, "asus"))      return "ASUS (SSID guess)";
+  if (containsNoCase(ssid, "fritz"))     return "AVM FRITZ!Box (SSID guess)";
+  if (containsNoCase(ssid, "dlink") || containsNoCase(ssid, "d-link")) return "D-Link (SSID guess)";
+  return nullptr;
+}
+
+const char* wifiChangeLabel(uint8_t type) {
+  switch (type) {
+    case WIFI_AP_ADDED:            return "New";
+    case WIFI_AP_REMOVED:          return "Gone";
+    case WIFI_AP_SECURITY_CHANGED: return "Security";
+    case WIFI_AP_CHANNEL_CHANGED:  return "Channel";
+    default:                       return "?";
+  }
+}
+
+void appendWifiChangesSection(PageBuffer& html) {
+  const WifiChangeSet& cs = lastWifiChanges;
+  if (cs.fromVersion == 0 || !latestWifi || cs.toVersion != latestWifi->version) return;
+
+  html.render(TPL("<h2>Changes since previous scan</h2>"));
+  html.render(TPL("<div class='subtle'>{} new, {} gone, {} security change(s), {} channel change(s)</div>"),
+              cs.added, cs.removed, cs.securityChanged, cs.channelChanged);
+  if (cs.count == 0) return;
+
+  html.render(TPL("<table class='table-list'><tr><th>Change</th><th>SSID</th><th>BSSID</th><th>Detail</th></tr>"));
+  for (uint16_t i = 0; i < cs.count && i < 16; ++i) {
+    const WifiChange& c = cs.changes[i];
+    const WifiApRecord* was = c.prevIdx != WIFI_NO_INDEX && previousWifi ? &previousWifi->aps[c.prevIdx] : nullptr;
+    const WifiApRecord* now = c.curIdx != WIFI_NO_INDEX ? &latestWifi->aps[c.curIdx] : nullptr;
+    const WifiApRecord* ap = now ? now : was;
+    if (!ap) continue;
+
+    html.render(TPL("<tr><td>{}</td><td>{}</td><td>{}</td><td>"),
+                wifiChangeLabel(c.type), htmlText(ap->ssid), bssidText(ap->bssid));
+    if (c.type == WIFI_AP_SECURITY_CHANGED && was) {
+      html.render(TPL("{} → {}"), encTypeToString(was->authMode), encTypeToString(now->authMode));
+    } else if (c.type == WIFI_AP_CHANNEL_CHANGED && was) {
+      html.render(TPL("Ch {} → {}"), (int)was->channel, (int)now->channel);
+    } else {
+      html.render(TPL("{}, ch {}"), encTypeToString(ap->authMode), (int)ap->channel);
+    }
+    html.render(TPL("</td></tr>"));
+  }
+  html.render(TPL("</table>"));
+}
 
-  if (s.indexOf("tp-link") >= 0 || s.indexOf("tplink") >= 0) return "TP-Link (SSID guess)";
-  if (s.indexOf("netgear") >= 0)   return "Netgear (SSID guess)";
-  if (s.indexOf("linksys") >= 0)   return "Linksys (SSID guess)";
-  if (s.indexOf("asus") >= 0)      return "ASUS (SSID guess)";
-  if (s.indexOf("fritz") >= 0)     return "AVM FRITZ!Box (SSID guess)";
-  if (s.indexOf("dlink") >= 0 || s.indexOf("d-link") >= 0) return "D-Link (SSID guess)";
+void appendWifiAlertsSection(PageBuffer& html) {
+  html.render(TPL("<h2>Alerts</h2>"));
+  if (wifiAlertCount == 0) {
+    html.render(TPL("<p>No rogue / evil-twin indicators so far.</p>"));
+    return;
+  }
 
-  // Fallback: just show OUI prefix
-  return "Unknown (OUI " + bssidPrefix + ")";
+  html.render(TPL("<table class='table-list'><tr><th></th><th>Alert</th><th>SSID</th><th>BSSID</th><th>Detail</th><th>Uptime</th></tr>"));
+  for (uint32_t age = 0; age < 10; ++age) {
+    const WifiAlert* a = recentWifiAlert(age);
+    if (!a) break;
+    html.render(TPL("<tr><td><span class='status-dot {}' style='display:inline-block'></span></td>"),
+                wifiAlertClass(a->type));
+    html.render(TPL("<td>{}</td><td>{}</td><td>{}</td><td>"), describeWifiAlert(a->type), htmlText(a->ssid), bssidText(a->bssid));
+    if (a->type == WIFI_ALERT_CHANNEL_CHANGE) html.render(TPL("Ch {} → {}"), (int)a->oldChannel, (int)a->newChannel);
+    else if (a->type == WIFI_ALERT_VENDOR_MISMATCH) html.render(TPL("OUI {}"), ouiText(a->bssid));
+    else html.render(TPL("{} → {}"), encTypeToString(a->oldAuth), encTypeToString(a->newAuth));
+    html.render(TPL("</td><td>{}</td></tr>"), uptimeAt(a->atMs));
+  }
+  html.render(TPL("</table>"));
+  html.render(TPL("<div class='subtle'>{}"
+                  " alert(s) since boot. Full feed: <a href='/api/alerts'>/api/alerts</a></div>"),
+              wifiAlertCount);
 }
 
-String buildWifiPage() {
-  String html = commonHtmlHead("ESP32 Wi-Fi Scan", "wifi");
-  html += "<h1>Wi-Fi Scan</h1>";
+void appendBackgroundScanToggle(PageBuffer& html) {
+  if (backgroundWifiScan) {
+    html.render(TPL("<p><a class='btn' href='/wifi?bgscan=off'>Disable background scan</a></p>"
+                    "<div class='subtle'>Scanning every {} s between page views. Each scan leaves the AP channel"
+                    " for a few seconds, so pages load slower while it runs.</div>"),
+                BACKGROUND_WIFI_INTERVAL_MS / 1000);
+  } else {
+    html.render(TPL("<p><a class='btn' href='/wifi?bgscan=on'>Enable background scan</a></p>"
+                    "<div class='subtle'>Alerts are checked whenever a page scans. Background scanning"
+                    " also checks every {} s when nobody is watching, at the cost of dashboard speed.</div>"),
+                BACKGROUND_WIFI_INTERVAL_MS / 1000);
+  }
+}
 
-  html += "<div class='card'>";
-  html += "<a class='btn' href='/wifi'>Scan Now</a>";
-  html += "<span class='subtle'>Each time you open or refresh this page, a new scan is performed.</span>";
-  html += "</div>";
+void buildAlertsJson(PageBuffer& json) {
+  unsigned long now = millis();
+  const WifiChangeSet& cs = lastWifiChanges;
+
+  json.append("{\"total\":", wifiAlertCount,
+              ",\"ssid_index_full\":", ssidIndexFull, ",\"oui_overflows\":", ssidOuiOverflows,
+              ",\"background_scan\":", backgroundWifiScan ? "true" : "false",
+              ",\"last_diff\":{\"from\":", cs.fromVersion, ",\"to\":", cs.toVersion,
+              ",\"added\":", cs.added, ",\"removed\":", cs.removed,
+              ",\"security_changed\":", cs.securityChanged, ",\"channel_changed\":", cs.channelChanged, "}");
+  json.append(",\"alerts\":[");
+  for (uint32_t age = 0; ; ++age) {
+    const WifiAlert* a = recentWifiAlert(age);
+    if (!a) break;
+    if (age) json.append(",");
+    json.append("{\"type\":", (int)a->type,
+                ",\"description\":\"", describeWifiAlert(a->type),
+                "\",\"bssid\":\"", bssidText(a->bssid),
+                "\",\"old_auth\":\"", encTypeToString(a->oldAuth),
+                "\",\"new_auth\":\"", encTypeToString(a->newAuth),
+                "\",\"old_channel\":", (int)a->oldChannel,
+                ",\"new_channel\":", (int)a->newChannel,
+                ",\"age_s\":", (now - a->atMs) / 1000,
+                ",\"ssid\":\"");
+    appendJsonEscaped(json, a->ssid);
+    json.append("\"}");
+  }
+  json.append("]}");
+}
 
-  int n = WiFi.scanNetworks();
-  if (n <= 0) {
-    html += "<p>No networks found.</p>";
+void buildWifiPage(PageBuffer& html, bool rescan) {
+  html.render(TPL("<h1>Wi-Fi Scan</h1>"));
+
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<a class='btn' href='/wifi'>Scan Now</a>"));
+  html.render(TPL("<span class='subtle'>Each time you open or refresh this page, a new scan is performed (viewers within a few seconds share one).</span>"));
+  html.render(TPL("</div>"));
+
+  const WifiSnapshot* snap = latestWifi;
+  if (!rescan && snap) appendCachedNotice(html, snap->takenMs);
+  if (!snap || snap->count == 0) {
+    html.render(TPL("<p>No networks found.</p>"));
   } else {
-    html += "<p>Found <span class='badge'>" + String(n) + " network(s)</span></p>";
-    html += "<table class='table-list'><tr>"
-            "<th>#</th><th>SSID</th><th>RSSI</th><th>Security</th><th>Ch</th><th>Details</th>"
-            "</tr>";
-    for (int i = 0; i < n; i++) {
-      html += "<tr>";
-      html += "<td>" + String(i + 1) + "</td>";
-      html += "<td>" + WiFi.SSID(i) + "</td>";
-      html += "<td>" + String(WiFi.RSSI(i)) + " dBm</td>";
-      html += "<td>" + encTypeToString(WiFi.encryptionType(i)) + "</td>";
-      html += "<td>" + String(WiFi.channel(i)) + "</td>";
-      html += "<td><a class='btn' href='/wifi/ap?idx=" + String(i) + "'>View</a></td>";
-      html += "</tr>";
+    html.render(TPL("<p>Found <span class='badge'>{} network(s)</span></p>"), snap->totalSeen);
+    html.render(TPL("<table class='table-list'><tr>"
+                    "<th>#</th><th>SSID</th><th>RSSI</th><th>Security</th><th>Ch</th><th>Details</th></tr>"));
+    for (int i = 0; i < snap->count; i++) {
+      const WifiApRecord& ap = snap->aps[i];
+      html.render(TPL("<tr>"));
+      html.render(TPL("<td>{}</td>"), i + 1);
+      html.render(TPL("<td>{}</td>"), htmlText(ap.ssid));
+      html.render(TPL("<td>{} dBm</td>"), (int)ap.rssi);
+      html.render(TPL("<td>{}</td>"), encTypeToString(ap.authMode));
+      html.render(TPL("<td>{}</td>"), (int)ap.channel);
+      html.render(TPL("<td><a class='btn' href='/wifi/ap?idx={}'>View</a></td>"), i);
+      html.render(TPL("</tr>"));
     }
-    html += "</table>";
+    html.render(TPL("</table>"));
   }
 
-  html += "<div class='footer'>ESP32 Monitor • Wi-Fi scan view</div></div></body></html>";
-  return html;
+  appendWifiChangesSection(html);
+  appendWifiAlertsSection(html);
+  appendBackgroundScanToggle(html);
+
+  html.render(TPL("<div class='footer'>ESP32 Monitor • Wi-Fi scan view</div></div></body></html>"));
 }
 
-String buildWifiApDetailPage(int idx) {
-  String html = commonHtmlHead("Wi-Fi AP Details", "wifi");
-  html += "<h1>Wi-Fi Access Point</h1>";
+void buildWifiApDetailPage(PageBuffer& html, int idx) {
+  appendHtmlHead(html, "Wi-Fi AP Details", "wifi");
+  html.render(TPL("<h1>Wi-Fi Access Point</h1>"));
 
-  int n = WiFi.scanNetworks();
+  // Index refers to the list the user just saw, so reuse that snapshot
+  const WifiSnapshot* snap = latestWifi ? latestWifi : scanWifiSnapshot();
+  int n = snap ? snap->count : 0;
   if (idx < 0 || idx >= n) {
-    html += "<p>AP index out of range. Try rescanning from the Wi-Fi Scan page.</p>";
-    html += "<p><a class='btn' href='/wifi'>Back to Wi-Fi Scan</a></p>";
-    html += "<div class='footer'>ESP32 Monitor • Wi-Fi AP detail</div></div></body></html>";
-    return html;
+    html.render(TPL("<p>AP index out of range. Try rescanning from the Wi-Fi Scan page.</p>"));
+    html.render(TPL("<p><a class='btn' href='/wifi'>Back to Wi-Fi Scan</a></p>"));
+    html.render(TPL("<div class='footer'>ESP32 Monitor • Wi-Fi AP detail</div></div></body></html>"));
+    return;
   }
 
-  String ssid  = WiFi.SSID(idx);
-  int32_t rssi = WiFi.RSSI(idx);
-  int32_t ch   = WiFi.channel(idx);
-  String bssid = WiFi.BSSIDstr(idx);
-
-  String bssidPrefix = bssid.substring(0, 8); // OUI
-  String vendorGuess = guessRouterVendor(ssid, bssidPrefix);
+  const WifiApRecord& ap = snap->aps[idx];
+  const char* vendorGuess = guessRouterVendor(ap.ssid);
 
   // Rough "channel load" guess: count how many APs share this channel
   int nSameChannel = 0;
   for (int i = 0; i < n; ++i) {
-    if (WiFi.channel(i) == ch) nSameChannel++;
+    if (snap->aps[i].channel == ap.channel) nSameChannel++;
   }
 
-  String loadText;
-  String loadClass = "ok";
+  const char* loadText;
+  const char* loadClass = "ok";
   if (nSameChannel <= 2) {
     loadText = "Light (few neighbors)";
   } else if (nSameChannel <= 5) {
@@ -415,48 +1874,50 @@ String buildWifiApDetailPage(int idx) {
     loadClass = "bad";
   }
 
-  html += "<div class='card'>";
-  html += "<div class='status-pill'><span class='status-dot ok'></span><span>Beaconing</span></div>";
-  html += "<div class='status-pill'><span class='status-dot " + loadClass + "'></span><span>Channel Load: " + loadText + "</span></div>";
-  html += "</div>";
-
-  html += "<h2>Basic Info</h2><table>";
-  html += "<tr><td class='label'>SSID</td><td>" + ssid + "</td></tr>";
-  html += "<tr><td class='label'>BSSID</td><td>" + bssid + "</td></tr>";
-  html += "<tr><td class='label'>Channel</td><td>" + String(ch) + "</td></tr>";
-  html += "<tr><td class='label'>RSSI</td><td>" + String(rssi) + " dBm</td></tr>";
-  html += "<tr><td class='label'>Security</td><td>" + encTypeToString(WiFi.encryptionType(idx)) + "</td></tr>";
-  html += "</table>";
-
-  html += "<h2>Router Signature</h2><table>";
-  html += "<tr><td class='label'>Vendor (heuristic)</td><td>" + vendorGuess + "</td></tr>";
-  html += "<tr><td class='label'>OUI Prefix</td><td>" + bssidPrefix + "</td></tr>";
-  html += "<tr><td class='label'>SSID Pattern</td><td>" + (ssid.length() ? ssid : String("(hidden or blank)")) + "</td></tr>";
-  html += "</table>";
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot ok'></span><span>Beaconing</span></div>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span><span>Channel Load: {}"
+                  "</span></div>"),
+              loadClass, loadText);
+  html.render(TPL("</div>"));
+
+  html.render(TPL("<h2>Basic Info</h2><table>"));
+  html.render(TPL("<tr><td class='label'>SSID</td><td>{}</td></tr>"), htmlText(ap.ssid));
+  html.render(TPL("<tr><td class='label'>BSSID</td><td>{}</td></tr>"), bssidText(ap.bssid));
+  html.render(TPL("<tr><td class='label'>Channel</td><td>{}</td></tr>"), (int)ap.channel);
+  html.render(TPL("<tr><td class='label'>RSSI</td><td>{} dBm</td></tr>"), (int)ap.rssi);
+  html.render(TPL("<tr><td class='label'>Security</td><td>{}</td></tr>"), encTypeToString(ap.authMode));
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>Router Signature</h2><table>"));
+  if (vendorGuess) {
+    html.render(TPL("<tr><td class='label'>Vendor (heuristic)</td><td>{}</td></tr>"), vendorGuess);
+  } else {
+    html.render(TPL("<tr><td class='label'>Vendor (heuristic)</td><td>Unknown (OUI {})</td></tr>"), ouiText(ap.bssid));
+  }
+  html.render(TPL("<tr><td class='label'>OUI Prefix</td><td>{}</td></tr>"), ouiText(ap.bssid));
+  html.render(TPL("<tr><td class='label'>SSID Pattern</td><td>{}</td></tr>"),
+              htmlText(ap.ssid[0] ? ap.ssid : "(hidden or blank)"));
+  html.render(TPL("</table>"));
 
-  html += "<div class='subtle'>"
-          "This view heuristically fingerprints the AP from SSID and BSSID prefix. "
-          "Channel load is estimated from how many APs share the same channel—"
-          "not from real traffic counters."
-          "</div>";
+  html.render(TPL("<div class='subtle'>"
+                  "This view heuristically fingerprints the AP from SSID and BSSID prefix. "
+                  "Channel load is estimated from how many APs share the same channel—"
+                  "not from real traffic counters.</div>"));
 
-  html += "<p><a class='btn' href='/wifi'>Back to Wi-Fi Scan</a></p>";
+  html.render(TPL("<p><a class='btn' href='/wifi'>Back to Wi-Fi Scan</a></p>"));
 
-  html += "<div class='footer'>ESP32 Monitor • Wi-Fi AP detail</div></div></body></html>";
-  return html;
+  html.render(TPL("<div class='footer'>ESP32 Monitor • Wi-Fi AP detail</div></div></body></html>"));
 }
 
 // ---------- Bluetooth (BLE) list & detail ----------
 
-String classifyBleDeviceType(const String& name) {
-  String n = name;
-  n.toLowerCase();
-
-  if (n.indexOf("iphone") >= 0 || n.indexOf("ipad") >= 0 || n.indexOf("ios") >= 0) return "Phone / iOS device (name guess)";
-  if (n.indexOf("android") >= 0 || n.indexOf("pixel") >= 0 || n.indexOf("mi ") >= 0) return "Phone / Android device (name guess)";
-  if (n.indexOf("watch") >= 0 || n.indexOf("wear") >= 0 || n.indexOf("fitbit") >= 0 || n.indexOf("garmin") >= 0) return "Watch / wearable (name guess)";
-  if (n.indexOf("airpods") >= 0 || n.indexOf("buds") >= 0 || n.indexOf("ear") >= 0) return "Earbuds / audio (name guess)";
-  if (n.indexOf("tv") >= 0 || n.indexOf("light") >= 0 || n.indexOf("bulb") >= 0 || n.indexOf("plug") >= 0) return "Smart home / appliance (name guess)";
+const char* classifyBleDeviceType(const char* name) {
+  if (containsNoCase(name, "iphone") || containsNoCase(name, "ipad") || containsNoCase(name, "ios")) return "Phone / iOS device (name guess)";
+  if (containsNoCase(name, "android") || containsNoCase(name, "pixel") || containsNoCase(name, "mi ")) return "Phone / Android device (name guess)";
+  if (containsNoCase(name, "watch") || containsNoCase(name, "wear") || containsNoCase(name, "fitbit") || containsNoCase(name, "garmin")) return "Watch / wearable (name guess)";
+  if (containsNoCase(name, "airpods") || containsNoCase(name, "buds") || containsNoCase(name, "ear")) return "Earbuds / audio (name guess)";
+  if (containsNoCase(name, "tv") || containsNoCase(name, "light") || containsNoCase(name, "bulb") || containsNoCase(name, "plug")) return "Smart home / appliance (name guess)";
 
   return "Unknown category (name-based guess)";
 }
@@ -473,157 +1934,353 @@ float estimateDistanceMeters(int rssi, int txPowerDbm) {
   return d;
 }
 
-String buildBlePage() {
-  String html = commonHtmlHead("ESP32 Bluetooth Devices", "ble");
-  html += "<h1>Bluetooth Low Energy Devices</h1>";
+// Copy of the ingest counters taken under the lock
+struct BleIngestView {
+  BleIngestStats stats;
+  uint16_t tableSize;
+};
+
+BleIngestView readBleIngest() {
+  BleIngestView v;
+  BleDataLock lock;
+  v.stats     = bleIngest;
+  v.tableSize = bleTable.size();
+  return v;
+}
+
+void appendBleIngestSection(PageBuffer& html) {
+  BleIngestView v = readBleIngest();
+  html.render(TPL("<h2>Scan Pipeline</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Adverts/s offered</td><td>{} now • {} peak</td></tr>"),
+              v.stats.offeredRate, v.stats.peakOfferedRate);
+  html.render(TPL("<tr><td class='label'>Adverts/s accepted</td><td>{} now • {} peak</td></tr>"),
+              v.stats.rate, v.stats.peakRate);
+  html.render(TPL("<tr><td class='label'>Adverts received</td><td>{} ({} dropped, ring full)</td></tr>"),
+              bleRing.pushed.load(), bleRing.dropped.load());
+  html.render(TPL("<tr><td class='label'>Ring</td><td>{} / {} deepest backlog • {}</td></tr>"),
+              bleRing.highWater, bleRing.capacity(), bleRing.inPsram ? "PSRAM" : "internal");
+  html.render(TPL("<tr><td class='label'>Processed</td><td>{} in {} batches (largest {})</td></tr>"),
+              v.stats.processed, v.stats.batches, v.stats.maxBatch);
+  html.render(TPL("<tr><td class='label'>Device table</td><td>{} / {} ({} evicted, {} expired)</td></tr>"),
+              v.tableSize, bleTable.pool.capacity, v.stats.evictions, v.stats.expired);
+  html.render(TPL("</table>"));
+}
+
+void buildBleIngestJson(PageBuffer& json) {
+  BleIngestView v = readBleIngest();
+  json.append("{\"rate\":", v.stats.rate, ",\"peak_rate\":", v.stats.peakRate,
+              ",\"offered_rate\":", v.stats.offeredRate, ",\"peak_offered_rate\":", v.stats.peakOfferedRate);
+  json.append(",\"ring\":{\"capacity\":", bleRing.capacity(), ",\"pushed\":", bleRing.pushed.load(),
+              ",\"dropped\":", bleRing.dropped.load(), ",\"high_water\":", bleRing.highWater, "}");
+  json.append(",\"processed\":", v.stats.processed, ",\"batches\":", v.stats.batches,
+              ",\"max_batch\":", v.stats.maxBatch);
+  json.append(",\"table\":{\"size\":", v.tableSize, ",\"capacity\":", bleTable.pool.capacity,
+              ",\"evictions\":", v.stats.evictions, ",\"expired\":", v.stats.expired, "}}");
+}
 
-  html += "<div class='card'>";
-  html += "<a class='btn' href='/ble'>Scan Now</a>";
-  html += "<span class='subtle'>Short active scan for nearby BLE advertisers.</span>";
-  html += "</div>";
+void buildBlePage(PageBuffer& html) {
+  html.render(TPL("<h1>Bluetooth Low Energy Devices</h1>"));
+
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<a class='btn' href='/ble'>Refresh</a>"));
+  html.render(TPL("<span class='subtle'>Continuous active scan; devices heard in the last {} s.</span>"),
+              (unsigned long)(BLE_RECENT_MS / 1000));
+  html.render(TPL("</div>"));
 
   if (!pBLEScan) {
-    html += "<p>BLE not initialized.</p>";
-    html += "<div class='footer'>ESP32 Monitor • BLE view</div></div></body></html>";
-    return html;
+    html.render(TPL("<p>BLE not initialized.</p>"));
+    html.render(TPL("<div class='footer'>ESP32 Monitor • BLE view</div></div></body></html>"));
+    return;
   }
 
-  int scanTimeSeconds = 3;
-  BLEScanResults results = pBLEScan->start(scanTimeSeconds, false);
-  int count = results.getCount();
+  const BleSnapshot* snap = latestBle;
 
-  if (count == 0) {
-    html += "<p>No BLE devices found.</p>";
+  if (!snap || snap->count == 0) {
+    html.render(TPL("<p>No BLE devices found.</p>"));
   } else {
-    html += "<p>Found <span class='badge'>" + String(count) + " device(s)</span></p>";
-    html += "<table class='table-list'><tr>"
-            "<th>#</th><th>Name</th><th>Address</th><th>RSSI</th><th>Details</th>"
-            "</tr>";
-    for (int i = 0; i < count; i++) {
-      BLEAdvertisedDevice dev = results.getDevice(i);
-      String name = dev.getName().c_str();
-      if (name.length() == 0) name = "(unnamed)";
-      String addr = dev.getAddress().toString().c_str();
-      int rssi = dev.getRSSI();
-
-      html += "<tr>";
-      html += "<td>" + String(i + 1) + "</td>";
-      html += "<td>" + name + "</td>";
-      html += "<td>" + addr + "</td>";
-      html += "<td>" + String(rssi) + " dBm</td>";
-      html += "<td><a class='btn' href='/ble/dev?addr=" + addr + "'>View</a></td>";
-      html += "</tr>";
+    html.render(TPL("<p>Found <span class='badge'>{} device(s)</span></p>"), snap->totalSeen);
+    html.render(TPL("<table class='table-list'><tr>"
+                    "<th>#</th><th>Name</th><th>Address</th><th>RSSI</th><th>Details</th></tr>"));
+    for (int i = 0; i < snap->count; i++) {
+      const BleDeviceRecord& dev = snap->devices[i];
+
+      html.render(TPL("<tr>"));
+      html.render(TPL("<td>{}</td>"), i + 1);
+      html.render(TPL("<td>{}</td>"), htmlText(dev.name[0] ? dev.name : "(unnamed)"));
+      html.render(TPL("<td>{}</td>"), bleAddrText(dev.addr));
+      html.render(TPL("<td>{} dBm</td>"), (int)dev.rssi);
+      html.render(TPL("<td><a class='btn' href='/ble/dev?addr={}'>View</a></td>"), bleAddrText(dev.addr));
+      html.render(TPL("</tr>"));
     }
-    html += "</table>";
+    html.render(TPL("</table>"));
   }
 
-  pBLEScan->clearResults();
+  appendBleIngestSection(html);
 
-  html += "<div class='footer'>ESP32 Monitor • BLE view</div></div></body></html>";
-  return html;
+  html.render(TPL("<div class='footer'>ESP32 Monitor • BLE view</div></div></body></html>"));
 }
 
-String buildBleDetailPage(const String& addrQuery) {
-  String html = commonHtmlHead("BLE Device Details", "ble");
-  html += "<h1>BLE Device</h1>";
+void buildBleDetailPage(PageBuffer& html, const String& addrQuery) {
+  appendHtmlHead(html, "BLE Device Details", "ble");
+  html.render(TPL("<h1>BLE Device</h1>"));
 
   if (!pBLEScan) {
-    html += "<p>BLE not initialized.</p>";
-    html += "<p><a class='btn' href='/ble'>Back to BLE List</a></p>";
-    html += "<div class='footer'>ESP32 Monitor • BLE detail</div></div></body></html>";
-    return html;
-  }
-
-  int scanTimeSeconds = 3;
-  BLEScanResults results = pBLEScan->start(scanTimeSeconds, false);
-  int count = results.getCount();
-
-  BLEAdvertisedDevice* found = nullptr;
-  BLEAdvertisedDevice tmp;
-
-  for (int i = 0; i < count; i++) {
-    BLEAdvertisedDevice dev = results.getDevice(i);
-    String addr = dev.getAddress().toString().c_str();
-    if (addr == addrQuery) {
-      tmp = dev;
-      found = &tmp;
-      break;
-    }
+    html.render(TPL("<p>BLE not initialized.</p>"));
+    html.render(TPL("<p><a class='btn' href='/ble'>Back to BLE List</a></p>"));
+    html.render(TPL("<div class='footer'>ESP32 Monitor • BLE detail</div></div></body></html>"));
+    return;
   }
 
-  if (!found) {
-    html += "<p>Device not found in this scan. It may have stopped advertising.</p>";
-    html += "<p><a class='btn' href='/ble'>Back to BLE List</a></p>";
-    html += "<div class='footer'>ESP32 Monitor • BLE detail</div></div></body></html>";
-    pBLEScan->clearResults();
-    return html;
+  uint8_t addrBytes[6];
+  BleTableEntry entry;
+  if (!parseMac(addrQuery, addrBytes) || !lookupBleDevice(addrBytes, entry)) {
+    html.render(TPL("<p>Device not heard in the last {} minutes. It may have stopped advertising.</p>"),
+                (unsigned long)(BLE_TABLE_TTL_MS / 60000));
+    html.render(TPL("<p><a class='btn' href='/ble'>Back to BLE List</a></p>"));
+    html.render(TPL("<div class='footer'>ESP32 Monitor • BLE detail</div></div></body></html>"));
+    return;
   }
+  const BleDeviceRecord* found = &entry.rec;
+  unsigned long now = millis();
+  unsigned long sinceSeenS = (now - entry.lastSeenMs) / 1000;
+  bool recent = now - entry.lastSeenMs <= BLE_RECENT_MS;
 
-  String name = found->getName().c_str();
-  if (name.length() == 0) name = "(unnamed)";
-  String addr = found->getAddress().toString().c_str();
-  int rssi = found->getRSSI();
+  const char* name = found->name[0] ? found->name : "(unnamed)";
+  int rssi = found->rssi;
 
-  bool haveTxPower = found->haveTXPower();
-  int txPowerDbm   = haveTxPower ? found->getTXPower() : -59; // -59 as common 1m ref
+  bool haveTxPower = found->haveTxPower;
+  int txPowerDbm   = haveTxPower ? found->txPower : -59; // -59 as common 1m ref
   float distance   = estimateDistanceMeters(rssi, txPowerDbm);
 
-  String devType = classifyBleDeviceType(name);
+  const char* devType = classifyBleDeviceType(name);
 
-  html += "<div class='card'>";
-  html += "<div class='status-pill'><span class='status-dot ok'></span><span>Advertising seen in last scan</span></div>";
-  html += "</div>";
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span><span>Last advert {}"
+                  " s ago</span></div>"),
+              recent ? "ok" : "warn", sinceSeenS);
+  html.render(TPL("</div>"));
 
-  html += "<h2>Basic Info</h2><table>";
-  html += "<tr><td class='label'>Name</td><td>" + name + "</td></tr>";
-  html += "<tr><td class='label'>Address</td><td>" + addr + "</td></tr>";
-  html += "<tr><td class='label'>RSSI</td><td>" + String(rssi) + " dBm</td></tr>";
-  html += "<tr><td class='label'>Heuristic Type</td><td>" + devType + "</td></tr>";
-  html += "</table>";
+  html.render(TPL("<h2>Basic Info</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Name</td><td>{}</td></tr>"), htmlText(name));
+  html.render(TPL("<tr><td class='label'>Address</td><td>{}</td></tr>"), bleAddrText(found->addr));
+  html.render(TPL("<tr><td class='label'>RSSI</td><td>{} dBm</td></tr>"), rssi);
+  html.render(TPL("<tr><td class='label'>Heuristic Type</td><td>{}</td></tr>"), devType);
+  html.render(TPL("<tr><td class='label'>Adverts Heard</td><td>{} over {} s</td></tr>"),
+              entry.adverts, (now - entry.firstSeenMs) / 1000);
+  html.render(TPL("</table>"));
 
-  html += "<h2>TX Power / Distance</h2><table>";
+  html.render(TPL("<h2>TX Power / Distance</h2><table>"));
   if (haveTxPower) {
-    html += "<tr><td class='label'>TX Power (advertised)</td><td>" + String(txPowerDbm) + " dBm</td></tr>";
+    html.render(TPL("<tr><td class='label'>TX Power (advertised)</td><td>{} dBm</td></tr>"), txPowerDbm);
   } else {
-    html += "<tr><td class='label'>TX Power</td><td>Not advertised (using typical -59 dBm @ 1m)</td></tr>";
+    html.render(TPL("<tr><td class='label'>TX Power</td><td>Not advertised (using typical -59 dBm @ 1m)</td></tr>"));
   }
-  html += "<tr><td class='label'>Estimated Distance</td><td>~" + String(distance, 1) + " m (very approximate)</td></tr>";
-  html += "</table>";
+  html.render(TPL("<tr><td class='label'>Estimated Distance</td><td>~{} m (very approximate)</td></tr>"),
+              fixed(distance, 1));
+  html.render(TPL("</table>"));
 
   // Manufacturer data, if present
-  if (found->haveManufacturerData()) {
-    std::string md = found->getManufacturerData();
-    html += "<h2>Manufacturer Data</h2>";
-    html += "<div class='card'><div class='subtle'>Raw manufacturer data (first bytes shown in hex):</div><code>";
-    size_t showBytes = md.size() < 16 ? md.size() : 16;
+  if (found->mfgTotal > 0) {
+    html.render(TPL("<h2>Manufacturer Data</h2>"));
+    html.render(TPL("<div class='card'><div class='subtle'>Raw manufacturer data (first bytes shown in hex):</div><code>"));
     char buf[4];
-    for (size_t i = 0; i < showBytes; ++i) {
-      uint8_t b = (uint8_t)md[i];
-      snprintf(buf, sizeof(buf), "%02X", b);
-      html += buf;
-      if (i + 1 < showBytes) html += " ";
+    for (size_t i = 0; i < found->mfgLen; ++i) {
+      snprintf(buf, sizeof(buf), "%02X", found->mfg[i]);
+      html.render(TPL("{}{}"), buf, i + 1 < found->mfgLen ? " " : "");
     }
-    if (md.size() > showBytes) html += " ...";
-    html += "</code></div>";
+    if (found->mfgTotal > found->mfgLen) html.render(TPL(" ..."));
+    html.render(TPL("</code></div>"));
   }
 
-  html += "<div class='subtle'>"
-          "Distance, device type, and activity are inferred from RSSI, TX power, and name. "
-          "For more precise contact-tracing style analysis you’d track this device over time and "
-          "analyze advertising intervals and RSSI trends."
-          "</div>";
+  html.render(TPL("<div class='subtle'>"
+                  "Distance, device type, and activity are inferred from RSSI, TX power, and name. "
+                  "For more precise contact-tracing style analysis you’d track this device over time and "
+                  "analyze advertising intervals and RSSI trends.</div>"));
 
-  html += "<p><a class='btn' href='/ble'>Back to BLE List</a></p>";
+  html.render(TPL("<p><a class='btn' href='/ble'>Back to BLE List</a></p>"));
 
-  html += "<div class='footer'>ESP32 Monitor • BLE detail</div></div></body></html>";
-
-  pBLEScan->clearResults();
-  return html;
+  html.render(TPL("<div class='footer'>ESP32 Monitor • BLE detail</div></div></body></html>"));
 }
 
 // ---------- Crowd density page (/crowd) ----------
 
-String describeCrowdLevel(float score) {
+void appendPresenceSection(PageBuffer& html) {
+  BleDataLock lock;
+
+  html.render(TPL("<h2>Presence</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Devices present now</td><td>{}</td></tr>"), presence.active);
+  html.render(TPL("<tr><td class='label'>Peak since boot</td><td>{}</td></tr>"), presence.peakActive);
+  html.render(TPL("<tr><td class='label'>Entered / exited</td><td>{} / {}</td></tr>"), presence.enters, presence.exits);
+  html.render(TPL("<tr><td class='label'>Mean dwell</td><td>{} min</td></tr>"),
+              fixed(presence.meanDwellSeconds() / 60.0f, 1));
+  if (presence.dropped) {
+    html.render(TPL("<tr><td class='label'>Sessions dropped (table full)</td><td>{}</td></tr>"), presence.dropped);
+  }
+  html.render(TPL("</table>"));
+
+  uint32_t maxBin = 1;
+  for (int i = 0; i < DWELL_BINS; ++i) maxBin = max(maxBin, presence.dwellHistogram[i]);
+  html.render(TPL("<h2>Dwell time</h2><div class='heat-graph'>"));
+  for (int i = 0; i < DWELL_BINS; ++i) {
+    int height = (int)(presence.dwellHistogram[i] * 100 / maxBin);
+    html.render(TPL("<div class='heat-bar' title='{}: {}' style=\"height:{}%;\"></div>"),
+                DWELL_BIN_LABEL[i], presence.dwellHistogram[i], height);
+  }
+  html.render(TPL("</div>"));
+  html.render(TPL("<div class='temp-baseline'><span>{}</span><span>{}</span></div>"),
+              DWELL_BIN_LABEL[0], DWELL_BIN_LABEL[DWELL_BINS - 1]);
+
+  float maxAvg = 0.1f;
+  for (uint8_t h = 0; h < 24; ++h) maxAvg = max(maxAvg, presence.averageOccupancy(h));
+  html.render(TPL("<h2>Hourly occupancy</h2><div class='heat-graph'>"));
+  for (uint8_t h = 0; h < 24; ++h) {
+    float avg = presence.averageOccupancy(h);
+    int height = (int)(avg * 100.0f / maxAvg + 0.5f);
+    html.render(TPL("<div class='heat-bar' title='H{}: avg {}, peak {}' style=\"height:{}%;\"></div>"),
+                (int)h, fixed(avg, 1), presence.hourly[h].peak, height);
+  }
+  html.render(TPL("</div>"));
+  html.render(TPL("<div class='temp-baseline'><span>H0</span><span>H23</span></div>"));
+  html.render(TPL("<div class='subtle'>Hours are counted from boot (no real-time clock); hour {}"
+                  " is the current one.</div>"),
+              (int)currentHourSlot());
+
+  html.render(TPL("<h2>Recent enter/exit events</h2>"));
+  if (presence.eventCount == 0) {
+    html.render(TPL("<p>No presence events yet.</p>"));
+    return;
+  }
+  html.render(TPL("<table class='table-list'><tr><th>Event</th><th>Address</th><th>Uptime</th><th>Dwell</th></tr>"));
+  for (uint32_t age = 0; age < 10; ++age) {
+    const PresenceEvent* e = presence.recentEvent(age);
+    if (!e) break;
+    html.render(TPL("<tr><td>{}</td>"), e->type == PRESENCE_ENTER ? "Enter" : "Exit");
+    html.render(TPL("<td>{}</td>"), bleAddrText(e->addr));
+    html.render(TPL("<td>{}</td>"), uptimeAt(e->atMs));
+    if (e->type == PRESENCE_EXIT) html.render(TPL("<td>{} s</td></tr>"), e->dwellMs / 1000);
+    else                          html.render(TPL("<td>-</td></tr>"));
+  }
+  html.render(TPL("</table>"));
+}
+
+const uint64_t UNIQUE_WINDOW_MS[]    = { 5 * 60000ULL, 3600000ULL, 24 * 3600000ULL, 7 * 24 * 3600000ULL };
+const char*    UNIQUE_WINDOW_LABEL[] = { "5 min", "1 hour", "24 hours", "7 days" };
+const char*    UNIQUE_WINDOW_KEY[]   = { "5m", "1h", "24h", "7d" };
+const uint64_t UNIQUE_WINDOW_UNIT_MS[] = { 60000ULL, 3600000ULL, 3600000ULL, 86400000ULL };
+const char*    UNIQUE_WINDOW_UNIT[]    = { "min", "h", "h", "d" };
+const int      UNIQUE_WINDOWS        = 4;
+
+void appendUniqueSection(PageBuffer& html) {
+  uint32_t bleAddrs[UNIQUE_WINDOWS], blePayloads[UNIQUE_WINDOWS];
+  uint64_t covered[UNIQUE_WINDOWS];
+  uint64_t nowMs = uniqueClockMs();
+  {
+    BleDataLock lock;
+    for (int i = 0; i < UNIQUE_WINDOWS; ++i) {
+      bleAddrs[i]    = uniqueBleAddrs.uniqueWithin(UNIQUE_WINDOW_MS[i], nowMs, &covered[i]);
+      blePayloads[i] = uniqueBlePayloads.uniqueWithin(UNIQUE_WINDOW_MS[i], nowMs);
+    }
+  }
+
+  html.render(TPL("<h2>Unique Devices</h2><table class='table-list'><tr>"
+                  "<th>Window</th><th>Covers</th><th>BLE addresses</th><th>BLE payload types</th><th>Wi-Fi BSSIDs</th></tr>"));
+  for (int i = 0; i < UNIQUE_WINDOWS; ++i) {
+    html.render(TPL("<tr><td>Last {}</td><td>{} {}</td><td>~{}</td><td>~{}</td><td>~{}</td></tr>"),
+                UNIQUE_WINDOW_LABEL[i], fixed((float)covered[i] / UNIQUE_WINDOW_UNIT_MS[i], 1), UNIQUE_WINDOW_UNIT[i],
+                bleAddrs[i], blePayloads[i], uniqueBssids.uniqueWithin(UNIQUE_WINDOW_MS[i], nowMs));
+  }
+  html.render(TPL("</table>"));
+  html.render(TPL("<div class='subtle'>HyperLogLog estimates (about ±{}%) from {}"
+                  "-byte sketches per minute, 5 minutes, hour and day. Counts are over whole buckets, "
+                  "so each row covers the span shown, slightly more than its window. "
+                  "Phones rotate BLE addresses, so addresses over-count people; payload types under-count "
+                  "identical models.</div>"),
+              fixed(104.0f / sqrtf(HLL_REGISTERS), 1), (unsigned)sizeof(HllSketch));
+}
+
+// /api/unique: the standard windows, or ?window=<seconds> for any other up
+// to UNIQUE_MAX_WINDOW_MS
+void buildUniqueJson(PageBuffer& json, unsigned long windowSeconds) {
+  uint64_t windows[UNIQUE_WINDOWS];
+  const char* keys[UNIQUE_WINDOWS];
+  int count = UNIQUE_WINDOWS;
+  if (windowSeconds) {
+    windows[0] = (uint64_t)windowSeconds * 1000;
+    keys[0]    = "window";
+    count      = 1;
+  } else {
+    for (int i = 0; i < UNIQUE_WINDOWS; ++i) {
+      windows[i] = UNIQUE_WINDOW_MS[i];
+      keys[i]    = UNIQUE_WINDOW_KEY[i];
+    }
+  }
+
+  uint32_t counts[3][UNIQUE_WINDOWS];
+  uint64_t covered[UNIQUE_WINDOWS];
+  uint64_t nowMs = uniqueClockMs();
+  {
+    BleDataLock lock;
+    for (int i = 0; i < count; ++i) {
+      counts[0][i] = uniqueBleAddrs.uniqueWithin(windows[i], nowMs, &covered[i]);
+      counts[1][i] = uniqueBlePayloads.uniqueWithin(windows[i], nowMs);
+    }
+  }
+  for (int i = 0; i < count; ++i) counts[2][i] = uniqueBssids.uniqueWithin(windows[i], nowMs);
+
+  json.append("{\"precision\":", (unsigned)HLL_PRECISION, ",\"sketch_bytes\":", (unsigned)sizeof(HllSketch));
+  json.append(",\"covered_s\":{");
+  for (int i = 0; i < count; ++i) json.append(i ? ",\"" : "\"", keys[i], "\":", (uint32_t)(covered[i] / 1000));
+  json.append("}");
+  const char*          names[]   = { "ble_addresses", "ble_payloads", "bssids" };
+  const UniqueCounter* streams[] = { &uniqueBleAddrs, &uniqueBlePayloads, &uniqueBssids };
+  for (int s = 0; s < 3; ++s) {
+    json.append(",\"", names[s], "\":{\"added\":", streams[s]->added);
+    for (int i = 0; i < count; ++i) json.append(",\"", keys[i], "\":", counts[s][i]);
+    json.append("}");
+  }
+  json.append("}");
+}
+
+void buildPresenceJson(PageBuffer& json) {
+  BleDataLock lock;
+  unsigned long now = millis();
+
+  json.append("{\"version\":", presence.version,
+              ",\"active\":", presence.active,
+              ",\"peak\":", presence.peakActive,
+              ",\"observations\":", presence.observations,
+              ",\"enters\":", presence.enters,
+              ",\"exits\":", presence.exits,
+              ",\"dropped\":", presence.dropped,
+              ",\"mean_dwell_s\":", presence.meanDwellSeconds());
+
+  json.append(",\"dwell_histogram\":[");
+  for (int i = 0; i < DWELL_BINS; ++i) {
+    if (i) json.append(",");
+    if (i < DWELL_BINS - 1) json.append("{\"le_s\":", DWELL_BIN_LIMIT_S[i], ",\"count\":", presence.dwellHistogram[i], "}");
+    else                    json.append("{\"le_s\":null,\"count\":", presence.dwellHistogram[i], "}");
+  }
+
+  json.append("],\"current_hour\":", (int)currentHourSlot(), ",\"hourly\":[");
+  for (uint8_t h = 0; h < 24; ++h) {
+    if (h) json.append(",");
+    json.append("{\"avg\":", fixed(presence.averageOccupancy(h), 2), ",\"peak\":", presence.hourly[h].peak, "}");
+  }
+
+  json.append("],\"events\":[");
+  for (uint32_t age = 0; ; ++age) {
+    const PresenceEvent* e = presence.recentEvent(age);
+    if (!e) break;
+    if (age) json.append(",");
+    json.append("{\"type\":\"", e->type == PRESENCE_ENTER ? "enter" : "exit",
+                "\",\"addr\":\"", bleAddrText(e->addr),
+                "\",\"age_s\":", (now - e->atMs) / 1000,
+                ",\"dwell_s\":", e->dwellMs / 1000, "}");
+  }
+  json.append("]}");
+}
+
+const char* describeCrowdLevel(float score) {
   if (score < 3.0f) return "Very quiet (almost empty)";
   if (score < 8.0f) return "Light activity";
   if (score < 16.0f) return "Moderate crowd";
@@ -631,130 +2288,211 @@ String describeCrowdLevel(float score) {
   return "Highly crowded / RF noisy";
 }
 
-String buildCrowdPage() {
-  String html = commonHtmlHead("ESP32 Crowd Density", "crowd");
-  html += "<h1>Crowd Density</h1>";
+void buildCrowdPage(PageBuffer& html, bool rescan) {
+  html.render(TPL("<h1>Crowd Density</h1>"));
 
-  html += "<div class='card'>";
-  html += "<a class='btn' href='/crowd'>Measure Now</a>";
-  html += "<span class='subtle'>This is a heuristic based on Wi-Fi and BLE activity around the ESP32.</span>";
-  html += "</div>";
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<a class='btn' href='/crowd'>Measure Now</a>"));
+  html.render(TPL("<span class='subtle'>This is a heuristic based on Wi-Fi and BLE activity around the ESP32.</span>"));
+  html.render(TPL("</div>"));
 
   // Wi-Fi scan
-  int wifiCount = WiFi.scanNetworks();
+  const WifiSnapshot* wifiSnap = latestWifi;
+  int wifiCount = wifiSnap ? wifiSnap->totalSeen : 0;
 
-  // BLE scan
-  int bleCount = 0;
-  if (pBLEScan) {
-    BLEScanResults res = pBLEScan->start(2, false);
-    bleCount = res.getCount();
-    pBLEScan->clearResults();
-  }
+  // BLE devices heard recently by the continuous scan
+  const BleSnapshot* bleSnap = latestBle;
+  int bleCount = bleSnap ? bleSnap->totalSeen : 0;
+
+  if (!rescan && wifiSnap) appendCachedNotice(html, wifiSnap->takenMs);
 
   float crowdScore = wifiCount * 1.0f + bleCount * 0.5f;
-  String crowdDesc = describeCrowdLevel(crowdScore);
+  const char* crowdDesc = describeCrowdLevel(crowdScore);
 
-  String crowdClass = "ok";
+  const char* crowdClass = "ok";
   if (crowdScore >= 16.0f) crowdClass = "warn";
   if (crowdScore >= 30.0f) crowdClass = "bad";
 
-  html += "<div class='card'>";
-  html += "<div class='status-pill'><span class='status-dot " + crowdClass + "'></span><span>" + crowdDesc + "</span></div>";
-  html += "<div class='subtle'>Score ≈ Wi-Fi count × 1.0 + BLE count × 0.5</div>";
-  html += "</div>";
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span><span>{}</span></div>"),
+              crowdClass, crowdDesc);
+  html.render(TPL("<div class='subtle'>Score ≈ Wi-Fi count × 1.0 + BLE count × 0.5</div>"));
+  html.render(TPL("</div>"));
 
-  html += "<h2>Raw Counts</h2><table>";
-  html += "<tr><td class='label'>Wi-Fi networks detected</td><td>" + String(wifiCount) + "</td></tr>";
-  html += "<tr><td class='label'>BLE devices detected</td><td>" + String(bleCount) + "</td></tr>";
-  html += "<tr><td class='label'>Crowd score</td><td>" + String(crowdScore, 1) + "</td></tr>";
-  html += "</table>";
+  html.render(TPL("<h2>Raw Counts</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Wi-Fi networks detected</td><td>{}</td></tr>"), wifiCount);
+  html.render(TPL("<tr><td class='label'>BLE devices detected</td><td>{} (last {} s)</td></tr>"),
+              bleCount, (unsigned long)(BLE_RECENT_MS / 1000));
+  html.render(TPL("<tr><td class='label'>Crowd score</td><td>{}</td></tr>"), fixed(crowdScore, 1));
+  html.render(TPL("</table>"));
 
-  html += "<div class='subtle'>"
-          "This does not decode any payloads; it only counts how many radios are active nearby. "
-          "For motion / presence detection, you’d take multiple measurements over time and look for changes."
-          "</div>";
+  html.render(TPL("<div class='subtle'>"
+                  "This does not decode any payloads; it only counts how many radios are active nearby. "
+                  "Presence below follows every BLE advert heard by the continuous scan.</div>"));
 
-  html += "<div class='footer'>ESP32 Monitor • Crowd density view</div></div></body></html>";
-  return html;
+  appendUniqueSection(html);
+  appendPresenceSection(html);
+
+  html.render(TPL("<div class='footer'>ESP32 Monitor • Crowd density view</div></div></body></html>"));
 }
 
 // ---------- RF Interference page (/rf) ----------
 
-String describeRfLevel(float energy) {
+const char* describeRfLevel(float energy) {
   if (energy < 50.0f) return "Low RF energy";
   if (energy < 150.0f) return "Moderate RF energy";
   if (energy < 300.0f) return "High RF energy";
   return "Very high RF energy / noisy band";
 }
 
-String buildRfPage() {
-  String html = commonHtmlHead("ESP32 RF Interference", "rf");
-  html += "<h1>2.4 GHz Interference</h1>";
+void buildRfPage(PageBuffer& html, bool rescan) {
+  html.render(TPL("<h1>2.4 GHz Interference</h1>"));
 
-  html += "<div class='card'>";
-  html += "<a class='btn' href='/rf'>Measure Now</a>";
-  html += "<span class='subtle'>Heuristic “noise” estimate based on Wi-Fi beacons and signal strengths.</span>";
-  html += "</div>";
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<a class='btn' href='/rf'>Measure Now</a>"));
+  html.render(TPL("<span class='subtle'>Heuristic “noise” estimate based on Wi-Fi beacons and signal strengths.</span>"));
+  html.render(TPL("</div>"));
 
-  int n = WiFi.scanNetworks();
+  const WifiSnapshot* snap = latestWifi;
+  if (!rescan && snap) appendCachedNotice(html, snap->takenMs);
+  int n = snap ? snap->count : 0;
   if (n <= 0) {
-    html += "<p>No Wi-Fi networks detected. RF environment seems very quiet.</p>";
-    html += "<div class='footer'>ESP32 Monitor • RF interference view</div></div></body></html>";
-    return html;
+    html.render(TPL("<p>No Wi-Fi networks detected. RF environment seems very quiet.</p>"));
+    html.render(TPL("<div class='footer'>ESP32 Monitor • RF interference view</div></div></body></html>"));
+    return;
   }
 
   // Compute rough "RF energy" score: sum of (100 + RSSI) across all networks
   float totalEnergy = 0.0f;
-  int maxChannel = 14;
-  int channelCounts[15];
-  for (int i = 0; i <= maxChannel; ++i) channelCounts[i] = 0;
-
   for (int i = 0; i < n; ++i) {
-    int rssi = WiFi.RSSI(i);           // typically negative
+    int rssi = snap->aps[i].rssi;      // typically negative
     totalEnergy += max(0, 100 + rssi); // stronger signals contribute more
-    int ch = WiFi.channel(i);
-    if (ch >= 1 && ch <= maxChannel) channelCounts[ch]++;
   }
 
-  String rfDesc = describeRfLevel(totalEnergy);
-  String rfClass = "ok";
+  const char* rfDesc = describeRfLevel(totalEnergy);
+  const char* rfClass = "ok";
   if (totalEnergy >= 150.0f) rfClass = "warn";
   if (totalEnergy >= 300.0f) rfClass = "bad";
 
-  html += "<div class='card'>";
-  html += "<div class='status-pill'><span class='status-dot " + rfClass + "'></span><span>" + rfDesc + "</span></div>";
-  html += "<div class='subtle'>Energy score from nearby Wi-Fi beacons (higher = noisier band).</div>";
-  html += "</div>";
-
-  html += "<h2>Per-channel congestion</h2>";
-  html += "<div class='heat-graph'>";
-  for (int ch = 1; ch <= 13; ++ch) {
-    int count = channelCounts[ch];
-    int height = count * 15;
+  html.render(TPL("<div class='card'>"));
+  html.render(TPL("<div class='status-pill'><span class='status-dot {}'></span><span>{}</span></div>"),
+              rfClass, rfDesc);
+  html.render(TPL("<div class='subtle'>Energy score from nearby Wi-Fi beacons (higher = noisier band).</div>"));
+  html.render(TPL("</div>"));
+
+  const ChannelInterference& ci = latestInterference;
+  html.render(TPL("<h2>Per-channel interference</h2>"));
+  html.render(TPL("<div class='heat-graph'>"));
+  for (int ch = 1; ch <= RF_CHANNELS; ++ch) {
+    // Map -100..-30 dBm onto the bar height
+    int height = (int)((ci.scoreDbm[ch] - RF_FLOOR_DBM) * 100.0f / 70.0f + 0.5f);
     if (height > 100) height = 100;
-    html += "<div class='heat-bar' style=\"height:";
-    html += String(height);
-    html += "%;\"></div>";
+    html.render(TPL("<div class='heat-bar' title='Ch {}: {} dBm' style=\"height:{}%;\"></div>"),
+                ch, fixed(ci.scoreDbm[ch], 1), height);
+  }
+  html.render(TPL("</div>"));
+  html.render(TPL("<div class='temp-baseline'><span>Ch 1</span><span>Ch 13</span></div>"));
+  html.render(TPL("<div class='subtle'>Beacon power per channel including leakage from neighbours up to ±4 channels away.</div>"));
+
+  html.render(TPL("<table class='table-list'><tr><th>Ch</th><th>APs</th><th>Own power</th><th>Interference</th></tr>"));
+  for (int ch = 1; ch <= RF_CHANNELS; ++ch) {
+    html.render(TPL("<tr><td>{}{}{}</td>"), ch, ch == ci.bestChannel ? " ★" : "", ch == apChannel ? " (AP)" : "");
+    html.render(TPL("<td>{}</td>"), (int)ci.apCount[ch]);
+    html.render(TPL("<td>{} dBm</td>"), fixed(mwToDbm(ci.powerMw[ch]), 1));
+    html.render(TPL("<td>{} dBm</td></tr>"), fixed(ci.scoreDbm[ch], 1));
+  }
+  html.render(TPL("</table>"));
+
+  html.render(TPL("<h2>Soft AP channel</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Current AP channel</td><td>{}</td></tr>"), (int)apChannel);
+  html.render(TPL("<tr><td class='label'>Least-loaded of 1/6/11</td><td>{} ({} dBm)</td></tr>"),
+              (int)ci.bestChannel, fixed(ci.scoreDbm[ci.bestChannel], 1));
+  html.render(TPL("<tr><td class='label'>Auto channel</td><td>{} • {} move(s) since boot</td></tr>"),
+              autoApChannel ? "On" : "Off", apChannelMoves);
+  html.render(TPL("</table>"));
+  if (autoApChannel) {
+    html.render(TPL("<p><a class='btn' href='/rf?autoch=off'>Disable auto channel</a></p>"));
+  } else {
+    html.render(TPL("<p><a class='btn' href='/rf?autoch=on'>Enable auto channel</a></p>"));
   }
-  html += "</div>";
-  html += "<div class='temp-baseline'><span>Ch 1</span><span>Ch 13</span></div>";
+  html.render(TPL("<div class='subtle'>With auto channel on, the AP moves when another channel is at least {}"
+                  " dB quieter, at most once every {} minutes. Connected clients briefly reconnect.</div>"),
+              fixed(AP_CHANNEL_SWITCH_MARGIN_DB, 0), AP_CHANNEL_MIN_DWELL_MS / 60000);
 
-  html += "<h2>Summary</h2><table>";
-  html += "<tr><td class='label'>Wi-Fi networks detected</td><td>" + String(n) + "</td></tr>";
-  html += "<tr><td class='label'>RF energy score</td><td>" + String(totalEnergy, 1) + "</td></tr>";
-  html += "</table>";
+  html.render(TPL("<h2>Summary</h2><table>"));
+  html.render(TPL("<tr><td class='label'>Wi-Fi networks detected</td><td>{}</td></tr>"), snap->totalSeen);
+  html.render(TPL("<tr><td class='label'>RF energy score</td><td>{}</td></tr>"), fixed(totalEnergy, 1));
+  html.render(TPL("</table>"));
 
-  html += "<div class='subtle'>"
-          "This does not measure true noise floor; it infers RF activity from visible Wi-Fi beacons. "
-          "Strong spikes over time may correlate with things like microwaves or other 2.4 GHz sources."
-          "</div>";
+  html.render(TPL("<div class='subtle'>"
+                  "This does not measure true noise floor; it infers RF activity from visible Wi-Fi beacons. "
+                  "Strong spikes over time may correlate with things like microwaves or other 2.4 GHz sources."
+                  "</div>"));
 
-  html += "<div class='footer'>ESP32 Monitor • RF interference view</div></div></body></html>";
-  return html;
+  html.render(TPL("<div class='footer'>ESP32 Monitor • RF interference view</div></div></body></html>"));
 }
 
 // ---------- HTTP handlers ----------
 
+// Send straight from the arena buffer; no String copy of the body is made
+void sendPage(const PageBuffer& page, const char* contentType = "text/html") {
+  server.send_P(200, contentType, page.c_str(), page.length());
+}
+
+// Answer from a cache entry, or with 304 if the client already has it. The
+// entry holds the body only; head is the page's head, sent in front of it.
+void sendCacheEntry(const PageCacheEntry& e, const char* head, size_t headLength) {
+  char etag[24];
+  pageCache.formatEtag(e, etag, sizeof(etag));
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  if (server.header("If-None-Match") == etag) {
+    pageCache.notModified++;
+    server.send(304);
+    return;
+  }
+  server.setContentLength(headLength + e.length);
+  server.send(200, "text/html", "");
+  server.sendContent(head, headLength);
+  server.sendContent(e.body, e.length);
+}
+
+// Serve page from the cache if its data has not changed since it was
+// last rendered. On false the caller renders the head with
+// appendCachedPageHead, then the body, and calls sendAndCachePage.
+bool sendCachedPage(CachedPage page, uint32_t dataVersion) {
+  const PageCacheEntry* e = pageCache.lookup(page, dataVersion);
+  if (!e) return false;
+  PageBuffer head(8192);
+  appendCachedPageHead(head, page);
+  sendCacheEntry(*e, head.c_str(), head.length());
+  return true;
+}
+
+// html holds the head (headLength bytes) followed by the body; only the
+// body goes into the cache
+void sendAndCachePage(CachedPage page, uint32_t dataVersion, const PageBuffer& html, size_t headLength) {
+  const PageCacheEntry* e = pageCache.store(page, dataVersion, html.c_str() + headLength, html.length() - headLength);
+  if (e) sendCacheEntry(*e, html.c_str(), headLength);
+  else   sendPage(html);
+}
+
+void sendOverloaded() {
+  server.sendHeader("Retry-After", String(retryAfterSeconds));
+  server.send(503, "text/plain", "Busy: too many scans in progress or heap is low. Please retry shortly.");
+}
+
+// Admit a request; returns false (after answering 503) if it was shed
+bool admit(RouteCost cost, unsigned long snapshotAge, bool* rescan) {
+  Admission a = admitRequest(cost, snapshotAge);
+  if (a == ADMIT_REJECT) {
+    sendOverloaded();
+    return false;
+  }
+  if (rescan) *rescan = (a == ADMIT_RUN);
+  return true;
+}
+
 void handleRoot() {
   // Redirect root to /device
   server.sendHeader("Location", String("/device"), true);
@@ -762,15 +2500,66 @@ void handleRoot() {
 }
 
 void handleDevice() {
-  server.send(200, "text/html", buildDevicePage());
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer html;
+  buildDevicePage(html);
+  sendPage(html);
+}
+
+void handleMemoryApi() {
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer json(512);
+  buildMemoryJson(json);
+  sendPage(json, "application/json");
+}
+
+void handleUniqueApi() {
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  unsigned long windowSeconds = server.hasArg("window") ? server.arg("window").toInt() : 0;
+  if (windowSeconds > UNIQUE_MAX_WINDOW_MS / 1000) {
+    server.send(400, "text/plain",
+                "window is longer than the day ring (max " + String((unsigned long)(UNIQUE_MAX_WINDOW_MS / 1000)) + " s)\n");
+    return;
+  }
+  PageBuffer json(512);
+  buildUniqueJson(json, windowSeconds);
+  sendPage(json, "application/json");
+}
+
+void handlePresenceApi() {
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer json(2048);
+  buildPresenceJson(json);
+  sendPage(json, "application/json");
+}
+
+void handleAlertsApi() {
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer json(2048);
+  buildAlertsJson(json);
+  sendPage(json, "application/json");
 }
 
 void handleEnvironment() {
-  server.send(200, "text/html", buildEnvironmentPage());
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer html;
+  buildEnvironmentPage(html);
+  sendPage(html);
 }
 
 void handleWifi() {
-  server.send(200, "text/html", buildWifiPage());
+  bool rescan;
+  if (!admit(COST_WIFI_SCAN, wifiSnapshotAge(), &rescan)) return;
+  // Like /rf?autoch, a rejected request must not change the setting
+  if (server.hasArg("bgscan")) backgroundWifiScan = (server.arg("bgscan") == "on");
+  if (rescan) scanWifiSnapshot();
+  uint32_t version = pageDataVersion(PAGE_WIFI, rescan);
+  if (sendCachedPage(PAGE_WIFI, version)) return;
+  PageBuffer html;
+  appendCachedPageHead(html, PAGE_WIFI);
+  size_t headLength = html.length();
+  buildWifiPage(html, rescan);
+  sendAndCachePage(PAGE_WIFI, version, html, headLength);
 }
 
 void handleWifiApDetail() {
@@ -779,11 +2568,30 @@ void handleWifiApDetail() {
     return;
   }
   int idx = server.arg("idx").toInt();
-  server.send(200, "text/html", buildWifiApDetailPage(idx));
+  // Reuses the list the user just saw; only scans if there is none yet
+  if (!admit(latestWifi ? COST_LIGHT : COST_WIFI_SCAN, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer html;
+  buildWifiApDetailPage(html, idx);
+  sendPage(html);
 }
 
 void handleBle() {
-  server.send(200, "text/html", buildBlePage());
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  refreshBleSnapshot();
+  uint32_t version = pageDataVersion(PAGE_BLE);
+  if (sendCachedPage(PAGE_BLE, version)) return;
+  PageBuffer html;
+  appendCachedPageHead(html, PAGE_BLE);
+  size_t headLength = html.length();
+  buildBlePage(html);
+  sendAndCachePage(PAGE_BLE, version, html, headLength);
+}
+
+void handleBleApi() {
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer json(512);
+  buildBleIngestJson(json);
+  sendPage(json, "application/json");
 }
 
 void handleBleDetail() {
@@ -791,16 +2599,43 @@ void handleBleDetail() {
     server.send(400, "text/plain", "Missing addr parameter");
     return;
   }
-  String addr = server.arg("addr");
-  server.send(200, "text/html", buildBleDetailPage(addr));
+  if (!admit(COST_LIGHT, NO_SNAPSHOT, nullptr)) return;
+  PageBuffer html;
+  buildBleDetailPage(html, server.arg("addr"));
+  sendPage(html);
 }
 
 void handleCrowd() {
-  server.send(200, "text/html", buildCrowdPage());
+  bool rescan;
+  if (!admit(COST_WIFI_SCAN, wifiSnapshotAge(), &rescan)) return;
+  if (rescan) scanWifiSnapshot();
+  refreshBleSnapshot();
+  uint32_t version = pageDataVersion(PAGE_CROWD, rescan);
+  if (sendCachedPage(PAGE_CROWD, version)) return;
+  PageBuffer html;
+  appendCachedPageHead(html, PAGE_CROWD);
+  size_t headLength = html.length();
+  buildCrowdPage(html, rescan);
+  sendAndCachePage(PAGE_CROWD, version, html, headLength);
 }
 
 void handleRf() {
-  server.send(200, "text/html", buildRfPage());
+  bool rescan;
+  if (!admit(COST_WIFI_SCAN, wifiSnapshotAge(), &rescan)) return;
+  if (rescan) scanWifiSnapshot();
+  // A rejected request must not change settings; apply after the scan so a
+  // move is judged on the freshest interference map
+  if (server.hasArg("autoch")) {
+    autoApChannel = (server.arg("autoch") == "on");
+    if (autoApChannel) considerApChannelMove(latestInterference);
+  }
+  uint32_t version = pageDataVersion(PAGE_RF, rescan);
+  if (sendCachedPage(PAGE_RF, version)) return;
+  PageBuffer html;
+  appendCachedPageHead(html, PAGE_RF);
+  size_t headLength = html.length();
+  buildRfPage(html, rescan);
+  sendAndCachePage(PAGE_RF, version, html, headLength);
 }
 
 void handleNotFound() {
@@ -811,16 +2646,27 @@ void handleNotFound() {
 
 // ---------- Setup & loop ----------
 
+// Boot stages report what they cost, so a board that runs short of
+// internal RAM shows where it went
+void logHeap(const char* stage) {
+  Serial.printf("Heap after %s: %u free, %u largest block\n", stage,
+                (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxAllocHeap());
+}
+
 void setup() {
   Serial.begin(115200);
   delay(1000);
 
   Serial.println();
   Serial.println("Starting ESP32 Monitor AP...");
+  Serial.printf("Last reset: %s\n", resetReasonToString(esp_reset_reason()));
 
-  // Wi-Fi: AP + STA so we can scan while running AP
+  logHeap("boot");
+
+  // Radio stacks first, so a short heap costs a table rather than the AP
+  // or BLE. Wi-Fi: AP + STA so we can scan while running AP
   WiFi.mode(WIFI_AP_STA);
-  bool apOk = WiFi.softAP(apSSID, apPASS);
+  bool apOk = WiFi.softAP(apSSID, apPASS, apChannel);
   if (apOk) {
     Serial.print("AP started. SSID: ");
     Serial.println(apSSID);
@@ -829,13 +2675,44 @@ void setup() {
   } else {
     Serial.println("Failed to start AP!");
   }
+  logHeap("Wi-Fi");
 
   // BLE init
   BLEDevice::init("ESP32-Monitor");
   pBLEScan = BLEDevice::getScan();
   pBLEScan->setActiveScan(true);
   pBLEScan->setInterval(100);
-  pBLEScan->setWindow(80);
+  pBLEScan->setWindow(50);  // leave the shared radio to Wi-Fi half the time
+  logHeap("BLE");
+
+  // Memory: carve long-lived tables out of what the radios left, the ones
+  // pages depend on first. allocLargeTable keeps a reserve free for lwIP
+  // and the server; each feature degrades on its own if its table is
+  // missing, but say so.
+  if (!requestArena.begin(psramFound() ? REQUEST_ARENA_PSRAM : REQUEST_ARENA_INTERNAL)) {
+    Serial.println("Request arena allocation failed");
+  }
+  if (!wifiSnapshotPool.begin(3)) Serial.println("Wi-Fi snapshot pool allocation failed");
+  if (!bleSnapshotPool.begin(2))  Serial.println("BLE snapshot pool allocation failed");
+  bool ingestOk = startBleIngest();
+  if (!presence.begin())          Serial.println("Presence table allocation failed");
+  if (!beginSsidIndex())          Serial.println("SSID index allocation failed");
+  if (!pageCache.begin())         Serial.println("Page cache allocation failed");
+  if (!beginUniqueCounters())     Serial.println("Unique-device sketch allocation failed");
+  Serial.printf("Request arena: %u bytes (%s)\n", (unsigned)requestArena.capacity,
+                requestArena.inPsram ? "PSRAM" : "internal");
+  Serial.printf("Tables: %u bytes internal, %u PSRAM, %u refused\n", (unsigned)largeTableBytesInternal,
+                (unsigned)largeTableBytesPsram, (unsigned)largeTablesRefused);
+  logHeap("tables");
+
+  // Scan forever; every advert (duplicates included, unparsed) goes to the
+  // ingest ring and is processed by bleIngestTask
+  if (ingestOk) {
+    pBLEScan->setAdvertisedDeviceCallbacks(&bleIngestCallbacks, true, false);
+    pBLEScan->start(0, nullptr, false);
+  } else {
+    Serial.println("BLE ingest could not start!");
+  }
 
   // Routes
   server.on("/",            handleRoot);
@@ -847,7 +2724,14 @@ void setup() {
   server.on("/ble/dev",     handleBleDetail);
   server.on("/crowd",       handleCrowd);
   server.on("/rf",          handleRf);
+  server.on("/api/mem",     handleMemoryApi);
+  server.on("/api/presence", handlePresenceApi);
+  server.on("/api/unique",  handleUniqueApi);
+  server.on("/api/alerts",  handleAlertsApi);
+  server.on("/api/ble",     handleBleApi);
   server.onNotFound(handleNotFound);
+  const char* cacheHeaders[] = { "If-None-Match" };
+  server.collectHeaders(cacheHeaders, 1);
   server.begin();
 
   Serial.println("HTTP server started");
@@ -860,5 +2744,12 @@ void loop() {
     lastSerialActivity = millis();
   }
 
+  // Each handleClient() serves at most one request, so the arena is
+  // request-scoped when reset here
+  requestArena.reset();
+  sampleHeapFragmentation();
   server.handleClient();
+
+  serviceBackgroundWifiScan();
+  applyPendingApChannel();
 }
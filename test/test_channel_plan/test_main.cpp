@@ -0,0 +1,91 @@
+#include <unity.h>
+
+#include <ChannelPlan.h>
+
+const uint8_t NON_OVERLAPPING[] = { 1, 6, 11 };
+
+float dbmToMw(float dbm) { return powf(10.0f, dbm / 10.0f); }
+
+void setUp() {}
+void tearDown() {}
+
+void test_kernel_is_symmetric_and_bounded() {
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, CHANNEL_OVERLAP_KERNEL[CHANNEL_OVERLAP_REACH]);
+  TEST_ASSERT_EQUAL_FLOAT(17.0f / 22.0f, channelOverlap(1));
+  TEST_ASSERT_EQUAL_FLOAT(2.0f / 22.0f, channelOverlap(4));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, channelOverlap(5));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, channelOverlap(-12));
+  for (int d = 1; d <= CHANNEL_OVERLAP_REACH; ++d) {
+    TEST_ASSERT_EQUAL_FLOAT(CHANNEL_OVERLAP_KERNEL[CHANNEL_OVERLAP_REACH - d],
+                            CHANNEL_OVERLAP_KERNEL[CHANNEL_OVERLAP_REACH + d]);
+    TEST_ASSERT_TRUE(channelOverlap(d) < channelOverlap(d - 1));
+  }
+}
+
+void test_one_ap_leaks_into_neighbours() {
+  float power[RF_CHANNELS + 1] = {};
+  float score[RF_CHANNELS + 1];
+  power[6] = dbmToMw(-50.0f);
+  spreadChannelPower(power, score);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -50.0f, score[6]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -50.0f + 10.0f * log10f(17.0f / 22.0f), score[5]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, -50.0f + 10.0f * log10f(2.0f / 22.0f), score[10]);
+  TEST_ASSERT_EQUAL_FLOAT(RF_FLOOR_DBM, score[1]);   // 5 channels away
+  TEST_ASSERT_EQUAL_FLOAT(RF_FLOOR_DBM, score[11]);
+}
+
+void test_power_adds_across_channels() {
+  float power[RF_CHANNELS + 1] = {};
+  float score[RF_CHANNELS + 1];
+  power[1] = dbmToMw(-60.0f);
+  power[2] = dbmToMw(-60.0f);
+  spreadChannelPower(power, score);
+  // Channel 1 hears itself plus 17/22 of channel 2
+  float expected = 10.0f * log10f(dbmToMw(-60.0f) * (1.0f + 17.0f / 22.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, expected, score[1]);
+}
+
+void test_floor_clamps_weak_and_empty() {
+  TEST_ASSERT_EQUAL_FLOAT(RF_FLOOR_DBM, mwToDbm(0.0f));
+  TEST_ASSERT_EQUAL_FLOAT(RF_FLOOR_DBM, mwToDbm(dbmToMw(-120.0f)));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, -30.0f, mwToDbm(0.001f));
+}
+
+void test_quietest_candidate() {
+  float power[RF_CHANNELS + 1] = {};
+  float score[RF_CHANNELS + 1];
+  power[1] = dbmToMw(-40.0f);
+  power[6] = dbmToMw(-45.0f);
+  spreadChannelPower(power, score);
+  TEST_ASSERT_EQUAL_UINT8(11, quietestChannel(score, NON_OVERLAPPING, 3));
+}
+
+void test_band_edge_is_never_chosen() {
+  float power[RF_CHANNELS + 1] = {};
+  float score[RF_CHANNELS + 1];
+  power[1] = dbmToMw(-50.0f);
+  power[9] = dbmToMw(-50.0f);
+  spreadChannelPower(power, score);
+  // 13 only hears the edge of channel 9 and is the quietest on the band
+  for (int ch = 1; ch < RF_CHANNELS; ++ch) TEST_ASSERT_TRUE(score[13] < score[ch]);
+  TEST_ASSERT_EQUAL_UINT8(6, quietestChannel(score, NON_OVERLAPPING, 3));
+}
+
+void test_tie_keeps_first_candidate() {
+  float score[RF_CHANNELS + 1];
+  for (int ch = 0; ch <= RF_CHANNELS; ++ch) score[ch] = RF_FLOOR_DBM;
+  TEST_ASSERT_EQUAL_UINT8(1, quietestChannel(score, NON_OVERLAPPING, 3));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_kernel_is_symmetric_and_bounded);
+  RUN_TEST(test_one_ap_leaks_into_neighbours);
+  RUN_TEST(test_power_adds_across_channels);
+  RUN_TEST(test_floor_clamps_weak_and_empty);
+  RUN_TEST(test_quietest_candidate);
+  RUN_TEST(test_band_edge_is_never_chosen);
+  RUN_TEST(test_tie_keeps_first_candidate);
+  return UNITY_END();
+}
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include <MacTable.h>
+
+void* allocLargeTable(size_t bytes, bool* inPsram) {
+  if (inPsram) *inPsram = false;
+  return calloc(1, bytes);
+}
+
+struct Entry {
+  uint8_t  addr[6];
+  uint16_t home, prev, next;
+  uint32_t value;
+};
+
+void makeAddr(uint32_t n, uint8_t addr[6]) {
+  addr[0] = 0x24;
+  addr[1] = 0x0A;
+  addr[2] = (uint8_t)(n >> 24);
+  addr[3] = (uint8_t)(n >> 16);
+  addr[4] = (uint8_t)(n >> 8);
+  addr[5] = (uint8_t)n;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_hash_is_stable_and_mixed() {
+  uint8_t a[6], b[6];
+  makeAddr(1, a);
+  makeAddr(2, b);
+  TEST_ASSERT_EQUAL_UINT32(hashBytes(a, 6), hashBytes(a, 6));
+  TEST_ASSERT_TRUE(hashBytes(a, 6) != hashBytes(b, 6));
+
+  // Sequential addresses must spread over the low bits used as an index
+  uint16_t buckets[64] = {};
+  for (uint32_t i = 0; i < 1024; ++i) {
+    makeAddr(i, a);
+    buckets[hashBytes(a, 6) & 63]++;
+  }
+  for (int i = 0; i < 64; ++i) TEST_ASSERT_LESS_THAN(40, buckets[i]);
+}
+
+void test_pool_acquire_release() {
+  ObjectPool<Entry> pool;
+  TEST_ASSERT_TRUE(pool.begin(3));
+  Entry* a = pool.acquire();
+  Entry* b = pool.acquire();
+  Entry* c = pool.acquire();
+  TEST_ASSERT_NOT_NULL(c);
+  TEST_ASSERT_NULL(pool.acquire());
+  TEST_ASSERT_EQUAL_UINT32(1, pool.failures);
+  TEST_ASSERT_EQUAL_UINT16(3, pool.peakInUse);
+
+  b->value = 42;
+  pool.release(b);
+  TEST_ASSERT_EQUAL_UINT16(2, pool.inUse());
+  Entry* again = pool.acquire();
+  TEST_ASSERT_EQUAL_PTR(b, again);
+  TEST_ASSERT_EQUAL_UINT32(0, again->value);  // zeroed on acquire
+  (void)a;
+}
+
+void test_insert_find_remove() {
+  MacTable<Entry> table;
+  TEST_ASSERT_TRUE(table.begin(8));
+  uint8_t addr[6];
+  for (uint32_t i = 0; i < 8; ++i) {
+    makeAddr(i, addr);
+    Entry* e = table.insert(addr);
+    TEST_ASSERT_NOT_NULL(e);
+    e->value = i;
+  }
+  TEST_ASSERT_TRUE(table.full());
+  makeAddr(99, addr);
+  TEST_ASSERT_NULL(table.insert(addr));
+
+  makeAddr(3, addr);
+  Entry* e = table.find(addr);
+  TEST_ASSERT_NOT_NULL(e);
+  TEST_ASSERT_EQUAL_UINT32(3, e->value);
+  table.remove(e);
+  TEST_ASSERT_NULL(table.find(addr));
+  TEST_ASSERT_EQUAL_UINT16(7, table.size());
+}
+
+void test_last_seen_order() {
+  MacTable<Entry> table;
+  TEST_ASSERT_TRUE(table.begin(4));
+  uint8_t addr[6];
+  Entry* e[3];
+  for (uint32_t i = 0; i < 3; ++i) {
+    makeAddr(i, addr);
+    e[i] = table.insert(addr);
+  }
+  TEST_ASSERT_EQUAL_PTR(e[0], table.oldest());
+  TEST_ASSERT_EQUAL_PTR(e[2], table.newest());
+
+  table.touch(e[0]);
+  TEST_ASSERT_EQUAL_PTR(e[1], table.oldest());
+  TEST_ASSERT_EQUAL_PTR(e[0], table.newest());
+  TEST_ASSERT_EQUAL_PTR(e[2], table.older(e[0]));
+  TEST_ASSERT_EQUAL_PTR(e[1], table.older(e[2]));
+  TEST_ASSERT_NULL(table.older(e[1]));
+
+  table.remove(e[2]);
+  TEST_ASSERT_EQUAL_PTR(e[1], table.older(e[0]));
+}
+
+// Removing from the middle of a probe chain must leave every other key
+// reachable (backward-shift deletion, no tombstones). A small index forces
+// long chains and wrap-around; a bitmap is the reference.
+void test_backward_shift_delete_keeps_chains() {
+  const uint16_t CAPACITY = 16;
+  const uint32_t KEYS     = 40;
+  MacTable<Entry> table;
+  TEST_ASSERT_TRUE(table.begin(CAPACITY));
+  bool present[KEYS] = {};
+  uint16_t count = 0;
+  uint8_t addr[6];
+
+  srand(1234);
+  for (int step = 0; step < 20000; ++step) {
+    uint32_t k = rand() % KEYS;
+    makeAddr(k, addr);
+    Entry* e = table.find(addr);
+    TEST_ASSERT_EQUAL(present[k], e != nullptr);
+    if (e) {
+      TEST_ASSERT_EQUAL_UINT32(k, e->value);
+      table.remove(e);
+      present[k] = false;
+      count--;
+    } else if (count < CAPACITY) {
+      e = table.insert(addr);
+      TEST_ASSERT_NOT_NULL(e);
+      e->value = k;
+      present[k] = true;
+      count++;
+    }
+    TEST_ASSERT_EQUAL_UINT16(count, table.size());
+  }
+  for (uint32_t k = 0; k < KEYS; ++k) {
+    makeAddr(k, addr);
+    TEST_ASSERT_EQUAL(present[k], table.find(addr) != nullptr);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_hash_is_stable_and_mixed);
+  RUN_TEST(test_pool_acquire_release);
+  RUN_TEST(test_insert_find_remove);
+  RUN_TEST(test_last_seen_order);
+  RUN_TEST(test_backward_shift_delete_keeps_chains);
+  return UNITY_END();
+}
@@ -0,0 +1,111 @@
+#include <string>
+#include <string.h>
+#include <unity.h>
+
+#include <PageTemplate.h>
+
+// Interleaves segments and values the way PageBuffer::render() does, into
+// a std::string so the output can be compared byte for byte.
+void renderSegments(std::string& out, const TemplateSegment* seg) { out.append(seg->text, seg->length); }
+
+void appendValue(std::string& out, const char* s) { out += s; }
+void appendValue(std::string& out, int v) { out += std::to_string(v); }
+
+template <typename T, typename... Rest>
+void renderSegments(std::string& out, const TemplateSegment* seg, const T& value, const Rest&... rest) {
+  out.append(seg->text, seg->length);
+  appendValue(out, value);
+  renderSegments(out, seg + 1, rest...);
+}
+
+template <size_t Slots, typename... Args>
+std::string render(const PageTemplate<Slots>& tpl, const Args&... args) {
+  static_assert(sizeof...(Args) == Slots, "template slots and arguments differ");
+  std::string out;
+  renderSegments(out, tpl.segments, args...);
+  return out;
+}
+
+void assertSegment(const char* expected, const TemplateSegment& seg) {
+  TEST_ASSERT_EQUAL_UINT(strlen(expected), seg.length);
+  TEST_ASSERT_EQUAL_STRING_LEN(expected, seg.text, seg.length);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Slot counts are compile-time constants
+static_assert(templateSlots("") == 0, "empty");
+static_assert(templateSlots("<br>") == 0, "no slots");
+static_assert(templateSlots("{}") == 1, "only a slot");
+static_assert(templateSlots("<td>{}</td><td>{} dBm</td>") == 2, "two slots");
+static_assert(templateSlots("{}{}{}") == 3, "adjacent slots");
+static_assert(templateSlots(".card { padding: 8px; } a{ }") == 0, "CSS braces");
+
+void test_segments_split_at_slots() {
+  const PageTemplate<2>& tpl = TPL("<td>{}</td><td>{} dBm</td>");
+  assertSegment("<td>", tpl.segments[0]);
+  assertSegment("</td><td>", tpl.segments[1]);
+  assertSegment(" dBm</td>", tpl.segments[2]);
+  TEST_ASSERT_EQUAL_UINT(strlen("<td></td><td> dBm</td>"), tpl.staticBytes);
+}
+
+// Segments point into the literal rather than copying it
+void test_segments_point_into_literal() {
+  static constexpr char text[] = "<p>{}</p>";
+  static constexpr PageTemplate<templateSlots(text)> tpl = parseTemplate<templateSlots(text)>(text);
+  TEST_ASSERT_EQUAL_PTR(text, tpl.segments[0].text);
+  TEST_ASSERT_EQUAL_PTR(text + 5, tpl.segments[1].text);
+}
+
+void test_slots_at_the_edges() {
+  const PageTemplate<2>& tpl = TPL("{} and {}");
+  assertSegment("", tpl.segments[0]);
+  assertSegment(" and ", tpl.segments[1]);
+  assertSegment("", tpl.segments[2]);
+  TEST_ASSERT_EQUAL_UINT(5, tpl.staticBytes);
+}
+
+void test_adjacent_slots() {
+  const PageTemplate<3>& tpl = TPL("{}{}{}");
+  for (int i = 0; i < 4; ++i) TEST_ASSERT_EQUAL_UINT(0, tpl.segments[i].length);
+  TEST_ASSERT_EQUAL_UINT(0, tpl.staticBytes);
+}
+
+// Only "{}" is a slot; other braces are text. In "{{}}" the inner pair is
+// the slot.
+void test_other_braces_are_text() {
+  const PageTemplate<0>& css = TPL("<style>.card { padding: 8px; } a{ }</style>");
+  assertSegment("<style>.card { padding: 8px; } a{ }</style>", css.segments[0]);
+
+  const PageTemplate<1>& nested = TPL("{{}}");
+  assertSegment("{", nested.segments[0]);
+  assertSegment("}", nested.segments[1]);
+}
+
+// Rendered output matches the text written out by hand
+void test_render_matches_hand_concatenation() {
+  TEST_ASSERT_EQUAL_STRING("<br>", render(TPL("<br>")).c_str());
+  TEST_ASSERT_EQUAL_STRING("<tr><td class='label'>RSSI</td><td>-67 dBm</td></tr>",
+                           render(TPL("<tr><td class='label'>RSSI</td><td>{} dBm</td></tr>"), -67).c_str());
+  TEST_ASSERT_EQUAL_STRING("<a class='nav-link active' href='/rf'><span class='icon rf'></span><span>RF</span></a>",
+                           render(TPL("<a class='nav-link{}' href='{}'><span class='icon {}'></span><span>{}</span></a>"),
+                                  " active", "/rf", "rf", "RF").c_str());
+  TEST_ASSERT_EQUAL_STRING("123", render(TPL("{}{}{}"), 1, 2, 3).c_str());
+  TEST_ASSERT_EQUAL_STRING("{x}", render(TPL("{{}}"), "x").c_str());
+
+  std::string empty = render(TPL("<td>{}</td>"), "");
+  TEST_ASSERT_EQUAL_MEMORY("<td></td>", empty.data(), empty.size());
+  TEST_ASSERT_EQUAL_UINT(9, empty.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_segments_split_at_slots);
+  RUN_TEST(test_segments_point_into_literal);
+  RUN_TEST(test_slots_at_the_edges);
+  RUN_TEST(test_adjacent_slots);
+  RUN_TEST(test_other_braces_are_text);
+  RUN_TEST(test_render_matches_hand_concatenation);
+  return UNITY_END();
+}
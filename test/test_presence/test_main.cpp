@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include <PresenceEngine.h>
+
+void* allocLargeTable(size_t bytes, bool* inPsram) {
+  if (inPsram) *inPsram = false;
+  return calloc(1, bytes);
+}
+
+const uint8_t HOUR = 3;
+
+struct Device {
+  uint8_t addr[6];
+  explicit Device(uint8_t n) : addr{ 0x5A, 0x11, 0x22, 0x33, 0x44, n } {}
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_no_enter_below_enter_threshold() {
+  PresenceEngine p;
+  TEST_ASSERT_TRUE(p.begin());
+  Device a(1);
+  p.observe(a.addr, PRESENCE_ENTER_RSSI - 1, 1000, HOUR);
+  p.observe(a.addr, PRESENCE_STAY_RSSI, 2000, HOUR);
+  TEST_ASSERT_EQUAL_UINT16(0, p.active);
+  TEST_ASSERT_EQUAL_UINT32(0, p.enters);
+  TEST_ASSERT_EQUAL_UINT32(2, p.observations);
+
+  p.observe(a.addr, PRESENCE_ENTER_RSSI, 3000, HOUR);
+  TEST_ASSERT_EQUAL_UINT16(1, p.active);
+  TEST_ASSERT_EQUAL_UINT32(1, p.enters);
+  TEST_ASSERT_EQUAL_UINT16(1, p.hourly[HOUR].peak);
+  TEST_ASSERT_EQUAL_UINT8(PRESENCE_ENTER, p.recentEvent(0)->type);
+}
+
+// Between the stay and enter thresholds a sighting cannot open a session
+// but does keep an open one alive; below the stay threshold it does neither.
+void test_weak_sightings_keep_session_alive() {
+  PresenceEngine p;
+  TEST_ASSERT_TRUE(p.begin());
+  Device a(1), b(2);
+  p.observe(a.addr, -70, 0, HOUR);
+  p.observe(b.addr, -70, 0, HOUR);
+  for (unsigned long t = 80000; t <= 400000; t += 80000) {
+    p.observe(a.addr, -85, t, HOUR);
+    p.observe(b.addr, PRESENCE_STAY_RSSI - 1, t, HOUR);
+  }
+  p.tick(400000, HOUR);
+  TEST_ASSERT_EQUAL_UINT16(1, p.active);
+  TEST_ASSERT_EQUAL_UINT32(1, p.exits);
+
+  // b was last seen at 0, so its dwell is zero
+  const PresenceEvent* e = p.recentEvent(0);
+  TEST_ASSERT_EQUAL_UINT8(PRESENCE_EXIT, e->type);
+  TEST_ASSERT_EQUAL_UINT8(2, e->addr[5]);
+  TEST_ASSERT_EQUAL_UINT32(0, e->dwellMs);
+}
+
+void test_exit_after_exit_timeout() {
+  PresenceEngine p;
+  TEST_ASSERT_TRUE(p.begin());
+  Device a(1);
+  p.observe(a.addr, -60, 1000, HOUR);
+  p.observe(a.addr, -60, 31000, HOUR);
+
+  p.tick(31000 + PRESENCE_EXIT_MS, HOUR);
+  TEST_ASSERT_EQUAL_UINT16(1, p.active);
+  p.tick(31000 + PRESENCE_EXIT_MS + 1, HOUR);
+  TEST_ASSERT_EQUAL_UINT16(0, p.active);
+  TEST_ASSERT_EQUAL_UINT32(1, p.exits);
+  TEST_ASSERT_EQUAL_UINT32(30000, p.recentEvent(0)->dwellMs);
+  TEST_ASSERT_EQUAL_UINT32(31000 + PRESENCE_EXIT_MS + 1, p.recentEvent(0)->atMs);
+
+  // Coming back after the exit is a new session
+  p.observe(a.addr, -60, 200000, HOUR);
+  TEST_ASSERT_EQUAL_UINT32(2, p.enters);
+}
+
+// Dwell is last sighting minus entry; each bin holds dwells below its limit
+void test_dwell_bins_at_boundaries() {
+  PresenceEngine p;
+  TEST_ASSERT_TRUE(p.begin());
+  const uint32_t dwellMs[] = { 59999, 60000, 119999, 120000, 14400000, 20000000 };
+  const int      bin[]     = { 0, 1, 1, 2, 9, 9 };
+  const int      n         = sizeof(dwellMs) / sizeof(dwellMs[0]);
+
+  for (int i = 0; i < n; ++i) {
+    Device d((uint8_t)i);
+    unsigned long start = 100000000UL * (i + 1);
+    for (uint32_t t = 0; t < dwellMs[i]; t += 60000) p.observe(d.addr, -60, start + t, HOUR);
+    p.observe(d.addr, -60, start + dwellMs[i], HOUR);
+    p.tick(start + dwellMs[i] + PRESENCE_EXIT_MS + 1, HOUR);
+    TEST_ASSERT_EQUAL_UINT32(dwellMs[i], p.recentEvent(0)->dwellMs);
+  }
+
+  uint32_t expected[DWELL_BINS] = {};
+  uint64_t total = 0;
+  for (int i = 0; i < n; ++i) {
+    expected[bin[i]]++;
+    total += dwellMs[i];
+  }
+  for (int i = 0; i < DWELL_BINS; ++i) TEST_ASSERT_EQUAL_UINT32(expected[i], p.dwellHistogram[i]);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)(total / n / 1000), p.meanDwellSeconds());
+}
+
+// Occupancy is the integral of open sessions over time, charged to the hour
+// slot passed in. A session counts until its exit is noticed.
+void test_occupancy_integrates_across_enter_and_exit() {
+  PresenceEngine p;
+  TEST_ASSERT_TRUE(p.begin());
+  Device a(1), b(2);
+  p.tick(10000, HOUR);                 // 10 s empty
+  p.observe(a.addr, -60, 10000, HOUR);
+  p.observe(b.addr, -60, 20000, HOUR); // 10 s with one
+  p.tick(40000, HOUR);                 // 20 s with two
+  TEST_ASSERT_EQUAL_UINT64(40000, p.hourly[HOUR].coveredMs);
+  TEST_ASSERT_EQUAL_UINT64(10000 + 2 * 20000, p.hourly[HOUR].occupancyMs);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.25f, p.averageOccupancy(HOUR));
+  TEST_ASSERT_EQUAL_UINT16(2, p.hourly[HOUR].peak);
+
+  // Both time out together; the next hour slot starts from zero
+  p.tick(20000 + PRESENCE_EXIT_MS + 1, HOUR);
+  TEST_ASSERT_EQUAL_UINT16(0, p.active);
+  TEST_ASSERT_EQUAL_UINT64(50000 + 2 * (PRESENCE_EXIT_MS - 19999), p.hourly[HOUR].occupancyMs);
+  p.tick(200000, HOUR + 1);
+  TEST_ASSERT_EQUAL_UINT64(200000 - (20000 + PRESENCE_EXIT_MS + 1), p.hourly[HOUR + 1].coveredMs);
+  TEST_ASSERT_EQUAL_UINT64(0, p.hourly[HOUR + 1].occupancyMs);
+  TEST_ASSERT_EQUAL_UINT16(0, p.hourly[HOUR + 1].peak);
+}
+
+// Sightings drained late from the BLE ring may be older than the last tick
+void test_late_sightings_do_not_integrate_backwards() {
+  PresenceEngine p;
+  TEST_ASSERT_TRUE(p.begin());
+  Device a(1);
+  p.tick(50000, HOUR);
+  p.observe(a.addr, -60, 45000, HOUR);
+  TEST_ASSERT_EQUAL_UINT64(50000, p.hourly[HOUR].coveredMs);
+  p.tick(60000, HOUR);
+  TEST_ASSERT_EQUAL_UINT64(10000, p.hourly[HOUR].occupancyMs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_enter_below_enter_threshold);
+  RUN_TEST(test_weak_sightings_keep_session_alive);
+  RUN_TEST(test_exit_after_exit_timeout);
+  RUN_TEST(test_dwell_bins_at_boundaries);
+  RUN_TEST(test_occupancy_integrates_across_enter_and_exit);
+  RUN_TEST(test_late_sightings_do_not_integrate_backwards);
+  return UNITY_END();
+}
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <thread>
+#include <unity.h>
+
+#include <SpscRing.h>
+
+void* allocLargeTable(size_t bytes, bool* inPsram) {
+  if (inPsram) *inPsram = false;
+  return calloc(1, bytes);
+}
+
+struct Item {
+  uint32_t seq;
+  uint32_t check;
+};
+
+bool push(SpscRing<Item>& ring, uint32_t seq) {
+  Item* slot = ring.reserve();
+  if (!slot) return false;
+  slot->seq   = seq;
+  slot->check = ~seq;
+  ring.commit();
+  return true;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_unstarted_ring_drops() {
+  SpscRing<Item> ring;
+  TEST_ASSERT_EQUAL_UINT32(0, ring.capacity());
+  TEST_ASSERT_FALSE(push(ring, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, ring.dropped.load());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.available());
+}
+
+void test_fill_counts_drops() {
+  SpscRing<Item> ring;
+  TEST_ASSERT_TRUE(ring.begin(8));
+  TEST_ASSERT_EQUAL_UINT32(8, ring.capacity());
+  for (uint32_t i = 0; i < 8; ++i) TEST_ASSERT_TRUE(push(ring, i));
+  TEST_ASSERT_FALSE(push(ring, 8));
+  TEST_ASSERT_FALSE(push(ring, 9));
+  TEST_ASSERT_EQUAL_UINT32(8, ring.pushed.load());
+  TEST_ASSERT_EQUAL_UINT32(2, ring.dropped.load());
+
+  // Freeing one slot lets exactly one more in
+  TEST_ASSERT_EQUAL_UINT32(8, ring.available());
+  ring.consume(1);
+  TEST_ASSERT_TRUE(push(ring, 10));
+  TEST_ASSERT_FALSE(push(ring, 11));
+}
+
+void test_peek_consume_in_order() {
+  SpscRing<Item> ring;
+  TEST_ASSERT_TRUE(ring.begin(4));
+  for (uint32_t i = 0; i < 3; ++i) push(ring, 100 + i);
+  TEST_ASSERT_EQUAL_UINT32(3, ring.available());
+  TEST_ASSERT_EQUAL_UINT32(100, ring.peek(0).seq);
+  TEST_ASSERT_EQUAL_UINT32(102, ring.peek(2).seq);
+
+  ring.consume(2);
+  TEST_ASSERT_EQUAL_UINT32(1, ring.available());
+  TEST_ASSERT_EQUAL_UINT32(102, ring.peek(0).seq);
+}
+
+// Indices run freely past the capacity; order must survive many laps
+void test_wraps_around() {
+  SpscRing<Item> ring;
+  TEST_ASSERT_TRUE(ring.begin(4));
+  uint32_t next = 0, expect = 0;
+  for (int lap = 0; lap < 50; ++lap) {
+    for (int i = 0; i < 3; ++i) TEST_ASSERT_TRUE(push(ring, next++));
+    uint32_t n = ring.available();
+    TEST_ASSERT_EQUAL_UINT32(3, n);
+    for (uint32_t i = 0; i < n; ++i) TEST_ASSERT_EQUAL_UINT32(expect++, ring.peek(i).seq);
+    ring.consume(n);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ring.available());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.dropped.load());
+}
+
+void test_high_water_tracks_deepest_backlog() {
+  SpscRing<Item> ring;
+  TEST_ASSERT_TRUE(ring.begin(8));
+  for (uint32_t i = 0; i < 5; ++i) push(ring, i);
+  ring.consume(ring.available());
+  push(ring, 5);
+  ring.available();
+  TEST_ASSERT_EQUAL_UINT32(5, ring.highWater);
+}
+
+// One producer thread racing one consumer thread: every item the producer
+// managed to commit arrives once, intact and in order, and commits plus
+// drops add up to the attempts.
+void test_two_threads_keep_order() {
+  const uint32_t ATTEMPTS = 200000;
+  SpscRing<Item> ring;
+  TEST_ASSERT_TRUE(ring.begin(64));
+
+  std::atomic<bool> done{false};
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < ATTEMPTS; ++i) push(ring, i);
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t received = 0, lastSeq = 0, corrupt = 0, outOfOrder = 0;
+  for (;;) {
+    bool finished = done.load(std::memory_order_acquire);
+    uint32_t n = ring.available();
+    for (uint32_t i = 0; i < n; ++i) {
+      const Item& item = ring.peek(i);
+      if (item.check != ~item.seq) corrupt++;
+      if (received && item.seq <= lastSeq) outOfOrder++;
+      lastSeq = item.seq;
+      received++;
+    }
+    ring.consume(n);
+    if (finished && n == 0) break;
+  }
+  producer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, corrupt);
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(ring.pushed.load(), received);
+  TEST_ASSERT_EQUAL_UINT32(ATTEMPTS, ring.pushed.load() + ring.dropped.load());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_unstarted_ring_drops);
+  RUN_TEST(test_fill_counts_drops);
+  RUN_TEST(test_peek_consume_in_order);
+  RUN_TEST(test_wraps_around);
+  RUN_TEST(test_high_water_tracks_deepest_backlog);
+  RUN_TEST(test_two_threads_keep_order);
+  return UNITY_END();
+}
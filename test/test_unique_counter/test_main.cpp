@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include <HashBytes.h>
+#include <UniqueCounter.h>
+
+void* allocLargeTable(size_t bytes, bool* inPsram) {
+  if (inPsram) *inPsram = false;
+  return calloc(1, bytes);
+}
+
+const uint64_t MINUTE_MS = 60000ULL;
+const uint64_t HOUR_MS   = 60 * MINUTE_MS;
+const uint64_t DAY_MS    = 24 * HOUR_MS;
+
+// Hash of a made-up BLE address, as the firmware feeds the sketches
+uint32_t itemHash(uint32_t n) {
+  uint8_t addr[6] = { 0x24, 0x0A, (uint8_t)(n >> 24), (uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n };
+  return hashBytes(addr, sizeof(addr));
+}
+
+// Three standard errors of the sketch
+void assertNear(uint32_t expected, uint32_t actual) {
+  float tolerance = 3.0f * 1.04f / sqrtf(HLL_REGISTERS) * expected + 1.0f;
+  TEST_ASSERT_FLOAT_WITHIN(tolerance, (float)expected, (float)actual);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_packed_registers_round_trip() {
+  HllSketch s;
+  s.clear();
+  for (uint16_t i = 0; i < HLL_REGISTERS; ++i) s.set(i, (i * 7 + 3) & 0x3F);
+  for (uint16_t i = 0; i < HLL_REGISTERS; ++i) TEST_ASSERT_EQUAL_UINT8((i * 7 + 3) & 0x3F, s.get(i));
+
+  // Rewriting one register leaves the ones sharing its bytes alone
+  s.set(5, 0);
+  s.set(6, 0x3F);
+  TEST_ASSERT_EQUAL_UINT8((4 * 7 + 3) & 0x3F, s.get(4));
+  TEST_ASSERT_EQUAL_UINT8(0, s.get(5));
+  TEST_ASSERT_EQUAL_UINT8(0x3F, s.get(6));
+  TEST_ASSERT_EQUAL_UINT8((7 * 7 + 3) & 0x3F, s.get(7));
+}
+
+void test_estimate_accuracy() {
+  const uint32_t sizes[] = { 0, 10, 100, 1000, 20000 };
+  for (uint32_t size : sizes) {
+    HllSketch s;
+    s.clear();
+    for (uint32_t n = 0; n < size; ++n) s.add(itemHash(n));
+    assertNear(size, s.estimate());
+  }
+}
+
+void test_duplicates_do_not_count() {
+  HllSketch once, many;
+  once.clear();
+  many.clear();
+  for (uint32_t n = 0; n < 500; ++n) once.add(itemHash(n));
+  for (int rep = 0; rep < 10; ++rep)
+    for (uint32_t n = 0; n < 500; ++n) many.add(itemHash(n));
+  TEST_ASSERT_EQUAL_UINT32(once.estimate(), many.estimate());
+}
+
+void test_merge_is_union() {
+  HllSketch a, b, all;
+  a.clear();
+  b.clear();
+  all.clear();
+  for (uint32_t n = 0; n < 3000; ++n) {
+    (n < 2000 ? a : b).add(itemHash(n));
+    if (n >= 1000 && n < 2000) b.add(itemHash(n));  // overlap
+    all.add(itemHash(n));
+  }
+  a.merge(b);
+  TEST_ASSERT_EQUAL_UINT32(all.estimate(), a.estimate());
+}
+
+// The merged span starts on a bucket boundary of the finest level that
+// holds the window: never shorter than the window, less than one bucket
+// longer. 5 min, 1 h, 24 h and 7 d land on minute, 5 min, hour and day
+// buckets.
+void test_covered_span_bounds() {
+  UniqueCounter c;
+  TEST_ASSERT_TRUE(c.begin());
+  const uint64_t windows[] = { 5 * MINUTE_MS, HOUR_MS, DAY_MS, 7 * DAY_MS };
+  const uint64_t spans[]   = { MINUTE_MS, 5 * MINUTE_MS, HOUR_MS, DAY_MS };
+  const uint64_t nows[]    = { 8 * DAY_MS, 8 * DAY_MS + 1, 9 * DAY_MS + 37 * MINUTE_MS + 12345, 30 * DAY_MS - 1 };
+  for (int w = 0; w < 4; ++w) {
+    for (uint64_t now : nows) {
+      uint64_t covered = 0;
+      c.uniqueWithin(windows[w], now, &covered);
+      TEST_ASSERT_TRUE(covered >= windows[w]);
+      TEST_ASSERT_TRUE(covered < windows[w] + spans[w]);
+    }
+  }
+}
+
+void test_short_uptime_covers_all_of_it() {
+  UniqueCounter c;
+  TEST_ASSERT_TRUE(c.begin());
+  for (uint32_t n = 0; n < 50; ++n) c.add(itemHash(n), 1000 + n * 1000);
+  uint64_t covered = 0;
+  assertNear(50, c.uniqueWithin(HOUR_MS, 90000, &covered));
+  TEST_ASSERT_EQUAL_UINT64(90000, covered);
+}
+
+void test_window_clamps_to_day_ring() {
+  UniqueCounter c;
+  TEST_ASSERT_TRUE(c.begin());
+  uint64_t now = 20 * DAY_MS + 5 * HOUR_MS;
+  uint64_t atMax = 0, beyond = 0;
+  c.uniqueWithin(UNIQUE_MAX_WINDOW_MS, now, &atMax);
+  c.uniqueWithin(30 * DAY_MS, now, &beyond);
+  TEST_ASSERT_EQUAL_UINT64(7 * DAY_MS, UNIQUE_MAX_WINDOW_MS);
+  TEST_ASSERT_EQUAL_UINT64(atMax, beyond);
+}
+
+// Items only count in windows that reach back to them
+void test_windows_see_only_their_span() {
+  UniqueCounter c;
+  TEST_ASSERT_TRUE(c.begin());
+  uint64_t t0 = 3 * DAY_MS;
+  for (uint32_t n = 0; n < 400; ++n) c.add(itemHash(n), t0);
+  for (uint32_t n = 400; n < 600; ++n) c.add(itemHash(n), t0 + 70 * MINUTE_MS);
+  for (uint32_t n = 600; n < 650; ++n) c.add(itemHash(n), t0 + 2 * HOUR_MS);
+
+  uint64_t now = t0 + 2 * HOUR_MS + 30000;
+  assertNear(50, c.uniqueWithin(5 * MINUTE_MS, now));
+  assertNear(250, c.uniqueWithin(HOUR_MS, now));
+  assertNear(650, c.uniqueWithin(DAY_MS, now));
+  assertNear(650, c.uniqueWithin(7 * DAY_MS, now));
+  TEST_ASSERT_EQUAL_UINT32(650, c.added);
+}
+
+// Ring slots are reused once their period has passed; nothing from before
+// the window may leak back in.
+void test_old_buckets_expire() {
+  UniqueCounter c;
+  TEST_ASSERT_TRUE(c.begin());
+  for (uint32_t n = 0; n < 300; ++n) c.add(itemHash(n), DAY_MS);
+  for (uint32_t n = 300; n < 310; ++n) c.add(itemHash(n), 9 * DAY_MS);
+
+  // Every level has lapped its ring since the first batch
+  uint64_t now = 9 * DAY_MS + 1000;
+  assertNear(10, c.uniqueWithin(5 * MINUTE_MS, now));
+  assertNear(10, c.uniqueWithin(DAY_MS, now));
+  assertNear(10, c.uniqueWithin(7 * DAY_MS, now));
+
+  // Without new traffic the windows drain to zero
+  now = 9 * DAY_MS + 2 * HOUR_MS;
+  TEST_ASSERT_EQUAL_UINT32(0, c.uniqueWithin(5 * MINUTE_MS, now));
+  TEST_ASSERT_EQUAL_UINT32(0, c.uniqueWithin(HOUR_MS, now));
+  assertNear(10, c.uniqueWithin(DAY_MS, now));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_packed_registers_round_trip);
+  RUN_TEST(test_estimate_accuracy);
+  RUN_TEST(test_duplicates_do_not_count);
+  RUN_TEST(test_merge_is_union);
+  RUN_TEST(test_covered_span_bounds);
+  RUN_TEST(test_short_uptime_covers_all_of_it);
+  RUN_TEST(test_window_clamps_to_day_ring);
+  RUN_TEST(test_windows_see_only_their_span);
+  RUN_TEST(test_old_buckets_expire);
+  return UNITY_END();
+}
@@ -0,0 +1,138 @@
+#include <unity.h>
+
+#include <WifiDiff.h>
+
+struct Scan {
+  WifiApRecord aps[8];
+  uint8_t      order[8];
+  uint16_t     count = 0;
+
+  void add(uint8_t last, uint8_t channel, uint8_t authMode) {
+    WifiApRecord& ap = aps[count++];
+    memset(&ap, 0, sizeof(ap));
+    ap.bssid[0] = 0xAA;
+    ap.bssid[5] = last;
+    ap.channel  = channel;
+    ap.authMode = authMode;
+  }
+
+  void sort() { sortByBssid(aps, order, count); }
+};
+
+struct Change {
+  uint8_t type, prevIdx, curIdx;
+};
+
+struct Recorder {
+  Change   changes[16];
+  uint16_t count = 0;
+
+  void operator()(uint8_t type, uint8_t prevIdx, uint8_t curIdx) {
+    changes[count++] = Change{ type, prevIdx, curIdx };
+  }
+};
+
+void diff(const Scan& prev, const Scan& cur, Recorder& out) {
+  diffByBssid(prev.aps, prev.order, prev.count, cur.aps, cur.order, cur.count,
+              [&out](uint8_t type, uint8_t prevIdx, uint8_t curIdx) { out(type, prevIdx, curIdx); });
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_sort_orders_by_bssid() {
+  Scan s;
+  const uint8_t lasts[] = { 9, 3, 7, 1, 5 };
+  for (uint8_t last : lasts) s.add(last, 1, 3);
+  s.sort();
+  for (uint16_t i = 1; i < s.count; ++i) {
+    TEST_ASSERT_TRUE(memcmp(s.aps[s.order[i - 1]].bssid, s.aps[s.order[i]].bssid, 6) < 0);
+  }
+  TEST_ASSERT_EQUAL_UINT8(3, s.order[0]);  // BSSID ...:01 was added fourth
+}
+
+void test_first_scan_is_all_added() {
+  Scan prev, cur;
+  cur.add(2, 1, 3);
+  cur.add(1, 6, 3);
+  cur.sort();
+  Recorder r;
+  diff(prev, cur, r);
+  TEST_ASSERT_EQUAL_UINT16(2, r.count);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_ADDED, r.changes[0].type);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_NO_INDEX, r.changes[0].prevIdx);
+  TEST_ASSERT_EQUAL_UINT8(1, r.changes[0].curIdx);  // BSSID order, not scan order
+  TEST_ASSERT_EQUAL_UINT8(0, r.changes[1].curIdx);
+}
+
+void test_unchanged_scan_reports_nothing() {
+  Scan prev, cur;
+  prev.add(1, 1, 3);
+  prev.add(2, 6, 4);
+  cur.add(2, 6, 4);  // different scan order, same APs
+  cur.add(1, 1, 3);
+  prev.sort();
+  cur.sort();
+  Recorder r;
+  diff(prev, cur, r);
+  TEST_ASSERT_EQUAL_UINT16(0, r.count);
+}
+
+void test_added_removed_and_changed() {
+  Scan prev, cur;
+  prev.add(1, 1, 3);   // removed
+  prev.add(3, 6, 3);   // security changed
+  prev.add(5, 11, 3);  // channel changed
+  prev.add(7, 1, 3);   // both changed
+  cur.add(7, 6, 0);
+  cur.add(5, 1, 3);
+  cur.add(4, 1, 3);    // added
+  cur.add(3, 6, 0);
+  prev.sort();
+  cur.sort();
+  Recorder r;
+  diff(prev, cur, r);
+
+  TEST_ASSERT_EQUAL_UINT16(6, r.count);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_REMOVED, r.changes[0].type);
+  TEST_ASSERT_EQUAL_UINT8(0, r.changes[0].prevIdx);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_NO_INDEX, r.changes[0].curIdx);
+
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_SECURITY_CHANGED, r.changes[1].type);
+  TEST_ASSERT_EQUAL_UINT8(1, r.changes[1].prevIdx);
+  TEST_ASSERT_EQUAL_UINT8(3, r.changes[1].curIdx);
+
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_ADDED, r.changes[2].type);
+  TEST_ASSERT_EQUAL_UINT8(2, r.changes[2].curIdx);
+
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_CHANNEL_CHANGED, r.changes[3].type);
+  TEST_ASSERT_EQUAL_UINT8(2, r.changes[3].prevIdx);
+  TEST_ASSERT_EQUAL_UINT8(1, r.changes[3].curIdx);
+
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_SECURITY_CHANGED, r.changes[4].type);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_CHANNEL_CHANGED, r.changes[5].type);
+  TEST_ASSERT_EQUAL_UINT8(3, r.changes[5].prevIdx);
+  TEST_ASSERT_EQUAL_UINT8(0, r.changes[5].curIdx);
+}
+
+void test_everything_gone() {
+  Scan prev, cur;
+  prev.add(1, 1, 3);
+  prev.add(2, 1, 3);
+  prev.sort();
+  Recorder r;
+  diff(prev, cur, r);
+  TEST_ASSERT_EQUAL_UINT16(2, r.count);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_REMOVED, r.changes[0].type);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_AP_REMOVED, r.changes[1].type);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sort_orders_by_bssid);
+  RUN_TEST(test_first_scan_is_all_added);
+  RUN_TEST(test_unchanged_scan_reports_nothing);
+  RUN_TEST(test_added_removed_and_changed);
+  RUN_TEST(test_everything_gone);
+  return UNITY_END();
+}